@@ -23,8 +23,8 @@ extern "C" {
 #include <stdbool.h>
 
 /* Configuration */
-#define DEBOUNCE_TIME_MS    5    /* Button debounce time in milliseconds */
 #define MAX_JOYSTICK_BUTTONS 16  /* Maximum buttons per joystick */
+#define JOYSTICK_BUTTON_MASK 0x1FFF  /* 13 buttons in the report (bits 0-12) */
 
 /* Dual Joystick Report Structure - 2 separate reports with Report ID */
 typedef struct {
@@ -34,15 +34,11 @@ typedef struct {
     uint16_t buttons;       /* 13 buttons (bits 0-12) + 3 padding (bits 13-15, must be 0) */
 } __attribute__((packed)) JoystickReport_t;
 
-/* Button mapping structure */
+/* Compiled mapping of one input vector bit */
 typedef struct {
-    GPIO_TypeDef* port;     /* GPIO port */
-    uint16_t pin;           /* GPIO pin */
-    uint8_t joystick_id;    /* 1 = Player 1, 2 = Player 2 */
-    uint8_t button_num;     /* Button number (0-15, or 255 for axis) */
-    uint8_t axis_dir;       /* 0=none, 1=up, 2=down, 3=left, 4=right */
-    bool active_low;        /* true if button is active LOW */
-} JoystickButtonMapping_t;
+    uint8_t player;         /* 0 = Player 1, 1 = Player 2 */
+    uint8_t function;       /* JoystickFunction_t from the flash config */
+} JoystickInputMap_t;
 
 /* Function prototypes */
 void Joystick_Init(void);
@@ -24,26 +24,28 @@ extern "C" {
 
 /* Configuration */
 #define USE_DIRECT_BUTTONS      /* Comment to enable JVS mode */
-#define MAX_BUTTONS             40  /* Maximum number of arcade buttons (34 used: 17 P1 + 17 P2) */
 
-/* HID Keyboard Report Structure (9 bytes: 1 ReportID + 8 data bytes) */
+/* Key bitmap covers usages 0x00-0x7F (letters, digits, F-keys, arrows, keypad) */
+#define NKRO_KEY_BITMAP_SIZE    16
+#define NKRO_KEY_MAX            0x7F
+#define NKRO_MODIFIER_FIRST     0xE0    /* LeftControl; 0xE0-0xE7 go to the modifier byte */
+#define NKRO_MODIFIER_LAST      0xE7    /* Right GUI */
+#define BOOT_KEY_COUNT          6
+#define BOOT_KEY_ROLLOVER       0x01    /* ErrorRollOver: more keys held than fit */
+
+/* HID Keyboard Report Structure (18 bytes: 1 ReportID + 1 modifier + 16 bitmap bytes) */
 typedef struct {
     uint8_t report_id;      /* Report ID = 1 */
     uint8_t modifiers;      /* Modifier keys (Ctrl, Shift, Alt, GUI) */
-    uint8_t reserved;       /* Reserved byte */
-    uint8_t keys[6];        /* 6 simultaneous keys (standard 6KRO) */
+    uint8_t keys[NKRO_KEY_BITMAP_SIZE]; /* One bit per usage: keys[usage >> 3] bit (usage & 7) */
 } NKRO_KeyboardReport_t;
 
-/* Button mapping structure */
+/* Boot protocol report (8 bytes, no Report ID), used when the host selects it */
 typedef struct {
-    GPIO_TypeDef* port;     /* GPIO port */
-    uint16_t pin;           /* GPIO pin */
-    uint8_t keycode;        /* USB HID keycode */
-    bool active_low;        /* true if button pulls to GND when pressed */
-} ButtonMapping_t;
-
-/* Debouncing configuration */
-#define DEBOUNCE_TIME_MS    5   /* Debounce time in milliseconds */
+    uint8_t modifiers;      /* Modifier keys (Ctrl, Shift, Alt, GUI) */
+    uint8_t reserved;       /* Reserved byte */
+    uint8_t keys[BOOT_KEY_COUNT];   /* Up to 6 pressed keys, or all ErrorRollOver */
+} Boot_KeyboardReport_t;
 
 /* Function prototypes */
 void Arcade_Init(void);
@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file           : device_mode.h
+  * @brief          : Runtime device mode selection (keyboard / joystick / JVS)
+  ******************************************************************************
+  * @attention
+  *
+  * One firmware image contains all three back ends. The active mode is
+  * stored in the flash config and fixed for the whole session: it is read
+  * once at boot, before USB enumeration, so the matching descriptors are
+  * presented to the host. A new mode takes effect after a reset.
+  *
+  * The mode can be changed with the USB_REQ_SET_MODE vendor request or by
+  * holding P1 Start plus one P1 button while powering up:
+  *   Start + silk 0 -> keyboard, Start + silk 1 -> joystick,
+  *   Start + silk 2 -> JVS.
+  *
+  * The legacy USE_KEYBOARD_MODE / USE_JOYSTICK_MODE / USE_JVS_MODE build
+  * defines now only select the mode used while the flash holds none.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __DEVICE_MODE_H
+#define __DEVICE_MODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include <stdint.h>
+
+/* Device modes (stored in flash, keep values stable) */
+typedef enum {
+    DEVICE_MODE_KEYBOARD = 0,   /* NKRO USB HID keyboard */
+    DEVICE_MODE_JOYSTICK = 1,   /* Dual USB HID joystick */
+    DEVICE_MODE_JVS = 2,        /* JVS I/O board on RS485 */
+    DEVICE_MODE_COUNT
+} DeviceMode_t;
+
+/* Mode used when the flash holds none */
+#if defined(USE_JOYSTICK_MODE)
+#define DEVICE_MODE_DEFAULT         DEVICE_MODE_JOYSTICK
+#elif defined(USE_JVS_MODE)
+#define DEVICE_MODE_DEFAULT         DEVICE_MODE_JVS
+#else
+#define DEVICE_MODE_DEFAULT         DEVICE_MODE_KEYBOARD
+#endif
+
+/* Boot chord: P1 Start plus P1 silk 0/1/2, held while powering up */
+#define DEVICE_MODE_CHORD_SILK      0x0A    /* P1 silk A (Start) */
+#define DEVICE_MODE_CHORD_HOLD_MS   50      /* Chord must still be held after this */
+
+/* Function prototypes */
+void DeviceMode_Init(void);
+DeviceMode_t DeviceMode_Get(void);
+HAL_StatusTypeDef DeviceMode_Set(DeviceMode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DEVICE_MODE_H */
@@ -13,6 +13,7 @@ extern "C" {
 #endif
 
 #include "main.h"
+#include "device_mode.h"
 
 /* Configuration storage address (last 2KB page of STM32F102RB) */
 #define CONFIG_FLASH_ADDR       0x0801F800  /* Last page at 126KB */
@@ -20,28 +21,14 @@ extern "C" {
 
 /* Magic number for configuration validation */
 #define CONFIG_MAGIC            0x48494430  /* "HID0" */
-#define CONFIG_VERSION          1
+#define CONFIG_VERSION          5   /* 3: poll_interval_ms, 4: all modes + device mode in one page,
+                                       5: debounce_mode */
 
 /* Maximum pins per player */
 #define MAX_PINS_PER_PLAYER     17
 
-#ifdef USE_KEYBOARD_MODE
-/* Keyboard mode configuration */
-typedef struct {
-    uint8_t silk_pin;       /* Silkscreen pin number (0-16) */
-    uint8_t hid_keycode;    /* USB HID keycode (0x04-0x65) */
-    char key_name[16];      /* Human readable name ("A", "SPACE", etc.) */
-} KeyboardMapping_t;
-
-typedef struct {
-    uint32_t magic;                             /* CONFIG_MAGIC */
-    uint32_t version;                           /* CONFIG_VERSION */
-    KeyboardMapping_t player1[MAX_PINS_PER_PLAYER];
-    KeyboardMapping_t player2[MAX_PINS_PER_PLAYER];
-    uint32_t crc32;                             /* CRC32 checksum */
-} KeyboardConfig_t;
-
-#else /* USE_JOYSTICK_MODE */
+/* USB polling interval (HID endpoint bInterval, full speed) */
+#define POLL_INTERVAL_DEFAULT_MS    1   /* 1000 Hz */
 
 /* Joystick function types */
 typedef enum {
@@ -66,7 +53,27 @@ typedef enum {
     JOY_FUNC_DISABLED       /* 18 - Pin not used */
 } JoystickFunction_t;
 
-/* Joystick mode configuration */
+/* Keyboard mode configuration */
+typedef struct {
+    uint8_t silk_pin;       /* Silkscreen pin number (0-16) */
+    uint8_t hid_keycode;    /* USB HID keycode (0x04-0x65) */
+    char key_name[16];      /* Human readable name ("A", "SPACE", etc.) */
+} KeyboardMapping_t;
+
+typedef struct {
+    uint32_t magic;                             /* CONFIG_MAGIC */
+    uint32_t version;                           /* CONFIG_VERSION */
+    KeyboardMapping_t player1[MAX_PINS_PER_PLAYER];
+    KeyboardMapping_t player2[MAX_PINS_PER_PLAYER];
+    uint8_t poll_interval_ms;                   /* 1, 2, 4, 8 or 10 */
+    uint8_t socd_mode[2];                       /* InputSocdMode_t, Player 1 / Player 2 */
+    uint8_t reserved;
+    uint8_t debounce_mode[2][MAX_PINS_PER_PLAYER];  /* By silk pin: InputDebounceMode_t or DEBOUNCE_PIN_DEFAULT */
+    uint8_t reserved2[2];
+    uint32_t crc32;                             /* CRC32 checksum */
+} KeyboardConfig_t;
+
+/* Joystick mode configuration (also used by JVS mode) */
 typedef struct {
     uint8_t silk_pin;           /* Silkscreen pin number (0-16) */
     uint8_t joy_function;       /* JoystickFunction_t */
@@ -78,10 +85,29 @@ typedef struct {
     uint32_t version;                           /* CONFIG_VERSION */
     JoystickMapping_t player1[MAX_PINS_PER_PLAYER];
     JoystickMapping_t player2[MAX_PINS_PER_PLAYER];
+    uint8_t poll_interval_ms;                   /* 1, 2, 4, 8 or 10 */
+    uint8_t socd_mode[2];                       /* InputSocdMode_t, Player 1 / Player 2 */
+    uint8_t reserved;
+    uint8_t debounce_mode[2][MAX_PINS_PER_PLAYER];  /* By silk pin: InputDebounceMode_t or DEBOUNCE_PIN_DEFAULT */
+    uint8_t reserved2[2];
     uint32_t crc32;                             /* CRC32 checksum */
 } JoystickConfig_t;
 
-#endif /* USE_KEYBOARD_MODE */
+/* Device mode record */
+typedef struct {
+    uint32_t magic;                             /* CONFIG_MAGIC */
+    uint8_t device_mode;                        /* DeviceMode_t */
+    uint8_t reserved[3];
+    uint32_t crc32;                             /* CRC32 checksum */
+} DeviceModeConfig_t;
+
+/* Flash page image: every part is validated on its own, so a bad part
+   falls back to its defaults without touching the others */
+typedef struct {
+    KeyboardConfig_t keyboard;
+    JoystickConfig_t joystick;
+    DeviceModeConfig_t mode;
+} FlashConfigStore_t;
 
 /* Public functions */
 HAL_StatusTypeDef FlashConfig_Load(void);
@@ -89,12 +115,12 @@ HAL_StatusTypeDef FlashConfig_Save(void);
 HAL_StatusTypeDef FlashConfig_Reset(void);
 uint8_t FlashConfig_IsValid(void);
 void FlashConfig_LoadDefaults(void);
+uint8_t FlashConfig_GetPollInterval(void);
+DeviceMode_t FlashConfig_GetDeviceMode(void);
+void FlashConfig_SetDeviceMode(DeviceMode_t mode);
 
-#ifdef USE_KEYBOARD_MODE
-KeyboardConfig_t* FlashConfig_Get(void);
-#else
-JoystickConfig_t* FlashConfig_Get(void);
-#endif
+KeyboardConfig_t* FlashConfig_GetKeyboard(void);
+JoystickConfig_t* FlashConfig_GetJoystick(void);
 
 #ifdef __cplusplus
 }
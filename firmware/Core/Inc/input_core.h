@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file           : input_core.h
+  * @brief          : Input subsystem shared by all output modes
+  ******************************************************************************
+  * @attention
+  *
+  * Runs the scan -> debounce -> SOCD pipeline once and exposes a single
+  * cleaned input vector. The keyboard, joystick and JVS back ends only
+  * translate that vector into their own report format.
+  *
+  * Each back end registers a mapping callback that compiles its lookup
+  * table (usually from the flash config). The callback runs at init and
+  * again from InputCore_Update() after InputCore_ReloadConfig(), with
+  * interrupts masked, so a table is never rebuilt while the back end (or
+  * its report builder in the USB interrupt) is reading it.
+  *
+  * The debounce algorithm is chosen per pin by the mapping callback
+  * through InputCore_SetDebounce() (flash config); pins it leaves at
+  * DEBOUNCE_PIN_DEFAULT, or that no callback sets, use DEBOUNCE_DEFAULT.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __INPUT_CORE_H
+#define __INPUT_CORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "input_scan.h"
+#include "input_debounce.h"
+#include "input_socd.h"
+
+/* Debouncing configuration (all modes) */
+#define DEBOUNCE_TIME_US    5000    /* Delayed: level must be stable this long (us) */
+#define DEBOUNCE_LOCKOUT_US 5000    /* Eager: edges ignored this long after a change (us) */
+#define DEBOUNCE_DEFAULT    DEBOUNCE_EAGER  /* Algorithm of pins without their own setting */
+#define DEBOUNCE_PIN_DEFAULT 0xFF           /* Per-pin setting: use DEBOUNCE_DEFAULT */
+
+/* Back end mapping compiler, called from main loop context only */
+typedef void (*InputCore_MapCallback_t)(void);
+
+/* Function prototypes */
+void InputCore_Init(InputCore_MapCallback_t apply_config);
+bool InputCore_Update(void);
+InputVector_t InputCore_GetState(void);
+uint32_t InputCore_GetSampleTime(void);
+uint32_t InputCore_GetEdgeTime(uint8_t bit);
+InputVector_t InputCore_GetPlayerMask(uint8_t player);
+void InputCore_SetDebounce(uint8_t player, const uint8_t* modes);
+void InputCore_ReloadConfig(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_CORE_H */
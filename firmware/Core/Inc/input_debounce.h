@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file           : input_debounce.h
+  * @brief          : Bit-parallel vertical-counter debounce
+  ******************************************************************************
+  * @attention
+  *
+  * Debounces the whole packed input vector at once. Every input owns one bit
+  * in each of INPUT_DEBOUNCE_PLANES counter words; a sample step is a few
+  * word-wide AND/XOR operations no matter how many inputs are scanned.
+  *
+  * Two algorithms, selectable per input:
+  *  - Delayed: an input changes state after it has read the new level for
+  *    debounce_us (counted in INPUT_DEBOUNCE_TICK_US ticks of sample time).
+  *  - Eager: the first edge is reported as soon as the sample carrying it is
+  *    processed, then the input is locked for lockout_us and any bounce in
+  *    that window is ignored. If the level differs when the lockout ends,
+  *    that change is reported immediately and starts a new lockout.
+  * Tick-based windows are accurate to one tick.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __INPUT_DEBOUNCE_H
+#define __INPUT_DEBOUNCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "input_scan.h"
+
+/* Configuration */
+#define INPUT_DEBOUNCE_TICK_US  250     /* Counter resolution */
+#define INPUT_DEBOUNCE_PLANES   6       /* Counter bits per input */
+#define INPUT_DEBOUNCE_MAX_TICKS ((1U << INPUT_DEBOUNCE_PLANES) - 2U)
+#define INPUT_DEBOUNCE_MAX_US   (INPUT_DEBOUNCE_MAX_TICKS * INPUT_DEBOUNCE_TICK_US)
+
+/* Per-input algorithm */
+typedef enum {
+    DEBOUNCE_DELAYED = 0,   /* Report after the level has been stable */
+    DEBOUNCE_EAGER          /* Report the first edge, then lock out */
+} InputDebounceMode_t;
+
+/* Function prototypes */
+void InputDebounce_Init(uint32_t debounce_us, uint32_t lockout_us, InputVector_t initial);
+void InputDebounce_SetEager(InputVector_t mask);
+bool InputDebounce_Update(const InputSample_t* sample);
+InputVector_t InputDebounce_GetState(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_DEBOUNCE_H */
@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file           : input_edge.h
+  * @brief          : EXTI edge-capture front end for the input scan engine
+  ******************************************************************************
+  * @attention
+  *
+  * Optional front end (INPUT_EDGE_CAPTURE) that timestamps every button
+  * transition in the EXTI interrupt with the microsecond timebase and hands
+  * it to the scan pipeline through a lock-free event queue.
+  *
+  * The STM32F1 has one EXTI line per pin number, shared by every port:
+  * PA3, PB3 and PC3 all use EXTI3 and only one of them can be routed to it.
+  * Each line is given to the first scanned pin found in port order
+  * (GPIOA, GPIOB, GPIOC); the other pins on that line keep being polled by
+  * the regular scan. With the current wiring this gives 16 edge-captured
+  * inputs out of 34.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __INPUT_EDGE_H
+#define __INPUT_EDGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "input_scan.h"
+
+/* Configuration */
+#ifndef INPUT_EDGE_CAPTURE
+#define INPUT_EDGE_CAPTURE      0       /* 1 = EXTI edge capture on top of the scan */
+#endif
+
+#define INPUT_EDGE_QUEUE_SIZE   32      /* Event queue depth (power of 2) */
+#define INPUT_EDGE_LINES        16      /* EXTI0..EXTI15 */
+
+/* One captured transition */
+typedef struct {
+    uint32_t time;          /* Timebase_Micros() at the edge */
+    uint8_t bit;            /* Input vector bit */
+    bool pressed;           /* Level after the edge (1 = pressed) */
+} InputEdgeEvent_t;
+
+/* Function prototypes */
+void InputEdge_Init(void);
+InputVector_t InputEdge_GetMask(void);
+bool InputEdge_GetEvent(InputEdgeEvent_t* event);
+bool InputEdge_TakeResync(InputVector_t* levels);
+void InputEdge_IRQ(uint16_t pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_EDGE_H */
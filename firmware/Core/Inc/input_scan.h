@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file           : input_scan.h
+  * @brief          : Port-snapshot input scan engine
+  ******************************************************************************
+  * @attention
+  *
+  * Latches GPIOA/GPIOB/GPIOC IDR once per scan and compacts the button pins
+  * into a single packed input vector (one bit per input, 1 = pressed).
+  * All three modes consume this vector instead of calling HAL_GPIO_ReadPin
+  * per button.
+  *
+  * Samples are delivered through a small queue. In INPUT_SCAN_POLL mode the
+  * main loop takes one snapshot per pass; in INPUT_SCAN_TIMER mode the TIM2
+  * update interrupt samples at a fixed SCAN_INTERVAL_US and the main loop
+  * only drains the queue. INPUT_SCAN_DMA lets TIM2 trigger DMA1 to copy the
+  * IDR registers into a circular buffer with no CPU involvement; the buffer
+  * is compacted into the queue from the half/full transfer interrupts.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __INPUT_SCAN_H
+#define __INPUT_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define INPUT_COUNT             34      /* 17 P1 + 17 P2 inputs */
+#define INPUT_PINS_PER_PLAYER   17      /* Silkscreen 0-9, A-F, 10 */
+#define INPUT_BIT_NONE          0xFF    /* Pin is not part of the input vector */
+
+/* Scan scheduling */
+#define INPUT_SCAN_POLL         0       /* One snapshot per main loop pass */
+#define INPUT_SCAN_TIMER        1       /* TIM2 update interrupt at SCAN_INTERVAL_US */
+#define INPUT_SCAN_DMA          2       /* TIM2 triggers DMA1 IDR copies at SCAN_INTERVAL_US */
+
+#ifndef INPUT_SCAN_MODE
+#define INPUT_SCAN_MODE         INPUT_SCAN_TIMER
+#endif
+
+#ifndef SCAN_INTERVAL_US
+#if INPUT_SCAN_MODE == INPUT_SCAN_DMA
+#define SCAN_INTERVAL_US        50      /* 20 kHz, costs no CPU per sample */
+#else
+#define SCAN_INTERVAL_US        500     /* 500 = 2 kHz, 250 = 4 kHz, 125 = 8 kHz */
+#endif
+#endif
+
+#define INPUT_DMA_BUFFER_SIZE   16      /* IDR samples per port, processed in halves */
+
+#define INPUT_QUEUE_SIZE        32      /* Sample queue depth (power of 2) */
+
+/* Packed input vector: bit n set = input n pressed (active-low pins inverted) */
+typedef uint64_t InputVector_t;
+
+/* One timestamped snapshot */
+typedef struct {
+    InputVector_t vector;   /* Pressed inputs */
+    uint32_t time;          /* Timebase_Micros() when the sample was taken */
+} InputSample_t;
+
+/* Input pin description */
+typedef struct {
+    GPIO_TypeDef* port;     /* GPIO port (GPIOA, GPIOB or GPIOC) */
+    uint16_t pin;           /* GPIO pin */
+} InputPin_t;
+
+/* Function prototypes */
+void InputScan_Init(void);
+InputVector_t InputScan_Read(void);
+uint8_t InputScan_PinBit(GPIO_TypeDef* port, uint16_t pin);
+uint8_t InputScan_SilkBit(uint8_t player, uint8_t silk_pin);
+
+void InputScan_Start(void);
+void InputScan_Poll(void);
+bool InputScan_GetSample(InputSample_t* sample);
+void InputScan_TimerTick(void);
+void InputScan_AlignTimer(uint32_t delay_us);
+uint32_t InputScan_GetOverruns(void);
+
+/**
+  * @brief  Test a single input in a vector
+  * @param  vector: Packed input vector
+  * @param  bit: Vector bit from InputScan_PinBit()
+  * @retval true if the input is pressed
+  */
+static inline bool InputScan_IsSet(InputVector_t vector, uint8_t bit)
+{
+    return (bit < 64) && ((vector >> bit) & 1U);
+}
+
+/**
+  * @brief  Pop the lowest set bit of a vector
+  * @param  vector: Vector to walk, must be non-zero; the bit is cleared
+  * @retval Bit index
+  */
+static inline uint8_t InputScan_NextBit(InputVector_t* vector)
+{
+    uint8_t bit = (uint8_t)__builtin_ctzll(*vector);
+    *vector &= *vector - 1U;
+    return bit;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_SCAN_H */
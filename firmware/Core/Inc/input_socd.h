@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file           : input_socd.h
+  * @brief          : SOCD cleaning of the debounced input vector
+  ******************************************************************************
+  * @attention
+  *
+  * Resolves simultaneous opposite cardinal directions (Left + Right,
+  * Up + Down) on each player's stick before any back end builds a report,
+  * so keyboard, joystick and JVS all see the same cleaned directions:
+  *  - Neutral: both opposite directions read as released.
+  *  - Last input wins: the direction pressed last is kept; releasing it
+  *    hands back to the one still held.
+  *  - Up priority: Up + Down reads as Up, Left + Right as neutral.
+  *
+  * The mode is stored per player in the active mode's flash config. The
+  * stick inputs come from the back end mapping: the joystick axis
+  * functions, or the standard stick pins (silk D-10) in keyboard and JVS
+  * modes. With SOCD_OFF on both players InputSocd_Apply() returns its
+  * input unchanged after a single test.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __INPUT_SOCD_H
+#define __INPUT_SOCD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "input_scan.h"
+
+/* SOCD resolution modes (stored in flash, keep values stable) */
+typedef enum {
+    SOCD_OFF = 0,           /* Opposite directions passed through */
+    SOCD_NEUTRAL = 1,       /* Both cancel out */
+    SOCD_LAST_WIN = 2,      /* Most recent press wins */
+    SOCD_UP_PRIORITY = 3,   /* Up wins, Left + Right neutral */
+    SOCD_MODE_COUNT
+} InputSocdMode_t;
+
+/* Standard stick pins, used where the mapping has no direction functions */
+#define SOCD_SILK_RIGHT         0x0D
+#define SOCD_SILK_LEFT          0x0E
+#define SOCD_SILK_DOWN          0x0F
+#define SOCD_SILK_UP            0x10
+
+/* Stick inputs of one player (INPUT_BIT_NONE if not wired) */
+typedef struct {
+    uint8_t up;
+    uint8_t down;
+    uint8_t left;
+    uint8_t right;
+} InputSocdStick_t;
+
+/* Function prototypes */
+void InputSocd_Init(void);
+void InputSocd_SetPlayer(uint8_t player, InputSocdMode_t mode, const InputSocdStick_t* stick);
+void InputSocd_SetStandardStick(uint8_t player, InputSocdMode_t mode);
+InputVector_t InputSocd_Apply(InputVector_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INPUT_SOCD_H */
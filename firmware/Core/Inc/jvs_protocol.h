@@ -40,6 +40,8 @@ extern "C" {
 #define JVS_CMD_RESET           0xF0
 #define JVS_CMD_RESET_ARG       0xD9
 #define JVS_CMD_ASSIGN_ADDR     0xF1
+#define JVS_CMD_COMM_CHANGE     0xF2    // Broadcast, no reply
+#define JVS_CMD_COMM_SUPPORTED  0xD2
 #define JVS_CMD_REQUEST_ID      0x10
 #define JVS_CMD_CMD_VER         0x11
 #define JVS_CMD_JVS_VER         0x12
@@ -74,15 +76,39 @@ extern "C" {
 #define JVS_CAP_LIGHTGUN        0x06
 #define JVS_CAP_GPI             0x07
 
+/* Communication methods (JVS_CMD_COMM_CHANGE argument, bit in the
+   JVS_CMD_COMM_SUPPORTED reply) */
+#define JVS_COMM_STANDARD       0       // 115200 baud
+#define JVS_COMM_1MBPS          1
+#define JVS_COMM_3MBPS          2
+#define JVS_COMM_COUNT          3
+#define JVS_COMM_NONE           0xFF
+
+/* The SN65HVD1786D is rated 1 Mbps, so 3 Mbps is not offered */
+#define JVS_COMM_METHODS        ((1U << JVS_COMM_STANDARD) | (1U << JVS_COMM_1MBPS))
+
 /* Board Configuration - CUSTOMIZE THIS */
 #define JVS_BOARD_NAME          "HIDO Arcade Controller"
 #define JVS_CMD_VERSION         0x11    // Command version 1.1
 #define JVS_JVS_VERSION         0x30    // JVS version 3.0
 #define JVS_COMM_VERSION        0x10    // Comm version 1.0
 #define JVS_NUM_PLAYERS         2       // 2 players
-#define JVS_BUTTONS_PER_PLAYER  8       // 8 buttons per player (+ start + service)
+#define JVS_BUTTONS_PER_PLAYER  10      // 10 buttons per player (+ start + service)
 #define JVS_NUM_COINS           2       // 2 coin slots
 
+/* Player switch bits in player_switches[1..] (sent MSB first, 2 bytes) */
+#define JVS_SW_START            15
+#define JVS_SW_SERVICE          14
+#define JVS_SW_UP               13
+#define JVS_SW_DOWN             12
+#define JVS_SW_LEFT             11
+#define JVS_SW_RIGHT            10
+#define JVS_SW_BUTTON(n)        (10 - (n))  // Button 1-10 -> bits 9-0
+
+/* System switch bits in player_switches[0] */
+#define JVS_SYS_TEST            7
+#define JVS_SYS_TILT1           6
+
 /* JVS Sense Line Control (PA2) */
 #define JVS_SENSE_PORT          GPIOA
 #define JVS_SENSE_PIN           GPIO_PIN_2
@@ -99,6 +125,7 @@ typedef struct {
     uint8_t device_id;
     uint16_t player_switches[JVS_NUM_PLAYERS + 1];  // +1 for system switches
     uint16_t coin_count[JVS_NUM_COINS];
+    uint8_t comm_method;            // JVS_COMM_*
     bool initialized;
 } JVS_State_t;
 
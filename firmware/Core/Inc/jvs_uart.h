@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file           : jvs_uart.h
+  * @brief          : JVS RS485 transport on USART1
+  ******************************************************************************
+  * @attention
+  *
+  * USART1 receives into a circular DMA buffer that the main loop drains
+  * without blocking. The DMA half/full transfer interrupts and the USART
+  * IDLE-line interrupt flag new data; the IDLE event marks the end of a
+  * frame, so the protocol layer gets whole frames in one batch. Bytes
+  * keep landing in the buffer while a reply is being transmitted.
+  *
+  * The buffer must be drained before it wraps: 256 bytes are 22 ms of
+  * traffic at 115200 baud.
+  *
+  * Replies go out by DMA. The SN65HVD1786D driver enable (PA8, DE and /RE
+  * tied) is asserted right before the first byte and released from the
+  * USART transmission-complete interrupt, once the last stop bit has left
+  * the shift register, so the CPU is free for the whole reply. A reply is
+  * held back until JVS_UART_TURNAROUND_US after the request ended (line
+  * idle), for hosts that switch their own driver off slowly; the delay
+  * and the DE setup time are timed by the timebase alarm, not by the main
+  * loop. The delay can be changed at run time and the measured response
+  * times are read with USB_REQ_GET_JVS_TIMING.
+  *
+  * The baud rate can be changed live (JVS communication method change):
+  * only BRR is rewritten, so the DMA reception keeps running. A rate is
+  * refused if the USART divider at PCLK2 misses it by more than
+  * JVS_UART_BAUD_TOLERANCE; at 48 MHz 115200 baud is off by 0.08 % and
+  * 1 Mbps is exact.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __JVS_UART_H
+#define __JVS_UART_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define JVS_UART_RX_SIZE        256     /* Circular DMA receive buffer */
+
+#define JVS_UART_BAUD_STANDARD  115200  /* JVS default communication method */
+#define JVS_UART_BAUD_TOLERANCE 20      /* Max baud rate error, 1/1000 */
+
+#ifndef JVS_UART_TURNAROUND_US
+#define JVS_UART_TURNAROUND_US  0       /* Minimum request end to reply delay */
+#endif
+
+#ifndef JVS_UART_DE_SETUP_US
+#define JVS_UART_DE_SETUP_US    2       /* Driver enable to first start bit */
+#endif
+
+/* RS485 driver enable (DE and /RE tied) */
+#define JVS_UART_DE_PORT        GPIOA
+#define JVS_UART_DE_PIN         GPIO_PIN_8
+
+/* Reply timing statistics (USB_REQ_GET_JVS_TIMING payload, little-endian) */
+typedef struct {
+    uint32_t replies;           /* Replies transmitted */
+    uint16_t response_min_us;   /* Request end (line idle) to first reply byte */
+    uint16_t response_avg_us;
+    uint16_t response_max_us;
+    uint16_t transmit_us;       /* Last reply: DE asserted to DE released */
+    uint16_t turnaround_us;     /* Current minimum response delay */
+    uint16_t de_setup_us;       /* JVS_UART_DE_SETUP_US */
+} JvsUartStats_t;
+
+/* Function prototypes */
+void JvsUart_Init(void);
+bool JvsUart_RxReady(void);
+uint16_t JvsUart_Peek(const uint8_t** data);
+void JvsUart_Consume(uint16_t len);
+bool JvsUart_Transmit(const uint8_t* data, uint16_t len);
+bool JvsUart_TxBusy(void);
+void JvsUart_SetTurnaround(uint16_t turnaround_us);
+bool JvsUart_SetBaudRate(uint32_t baud);
+void JvsUart_GetStats(JvsUartStats_t* stats);
+void JvsUart_ResetStats(void);
+
+/* Interrupt hook (USART1_IRQHandler) */
+void JvsUart_IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JVS_UART_H */
@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file           : timebase.h
+  * @brief          : Microsecond monotonic timebase
+  ******************************************************************************
+  * @attention
+  *
+  * 32-bit microsecond counter built from a TIM3 -> TIM4 cascade: TIM3 runs
+  * at 1 MHz and its update event clocks TIM4, so TIM4:TIM3 is a free-running
+  * 32-bit count in hardware with no interrupt load. It wraps every ~71.6
+  * minutes; always compare times with the helpers below, never with < or >.
+  *
+  * TIM3 channel 1 doubles as a one-shot alarm: Timebase_SetAlarm() calls
+  * Timebase_AlarmCallback() from the TIM3 interrupt once a deadline is
+  * reached, for work that must not wait on the main loop. There is a
+  * single alarm, owned by the JVS transport.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Function prototypes */
+void Timebase_Init(void);
+uint32_t Timebase_Micros(void);
+void Timebase_DelayUs(uint32_t us);
+void Timebase_SetAlarm(uint32_t deadline);
+void Timebase_CancelAlarm(void);
+void Timebase_AlarmCallback(void);
+
+/* Interrupt hook (TIM3_IRQHandler) */
+void Timebase_IRQHandler(void);
+
+/**
+  * @brief  Microseconds elapsed since an earlier timestamp (wrap-safe)
+  */
+static inline uint32_t Timebase_Elapsed(uint32_t since)
+{
+    return Timebase_Micros() - since;
+}
+
+/**
+  * @brief  Signed distance from b to a in microseconds (wrap-safe)
+  * @retval > 0 if a is after b, < 0 if a is before b
+  */
+static inline int32_t Timebase_Diff(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b);
+}
+
+/**
+  * @brief  Check whether a deadline has been reached (wrap-safe)
+  */
+static inline bool Timebase_Reached(uint32_t deadline)
+{
+    return Timebase_Diff(Timebase_Micros(), deadline) >= 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIMEBASE_H */
@@ -19,6 +19,19 @@
   * - wIndex: 0
   * - Data: None
   * 
+  * The same commands are accepted as 64-byte reports on the vendor data
+  * interface (usbd_hid_raw.c), which needs no kernel driver detach:
+  * - Request: [0] command  [1..2] wValue (LE)  [3] length  [4..] payload
+  * - Reply:   [0] command  [1] status  [2] length  [3] 0   [4..] data
+  * CONFIG_READ / CONFIG_WRITE move USB_RAW_PAYLOAD_SIZE bytes at a time,
+  * wValue being the byte offset. Write chunks must arrive in order from
+  * offset 0 (which restarts the write); a gap or empty chunk is refused
+  * and the whole configuration must be sent again. It is applied with
+  * its last chunk. SET_MODE, RESET_DEVICE and ENTER_BOOTLOADER reset the
+  * device from the main loop once their reply has been collected.
+  * Unsolicited packets (USB_RAW_EVENT_*) use the reply layout and may be
+  * interleaved with replies.
+  * 
   ******************************************************************************
   */
 
@@ -31,6 +44,7 @@ extern "C" {
 
 #include "stm32f1xx_hal.h"
 #include "usbd_def.h"
+#include "usbd_hid_raw.h"
 
 /* USB Vendor Request Codes */
 #define USB_REQ_ENTER_BOOTLOADER    0xBB    /* Request DFU bootloader entry */
@@ -39,6 +53,23 @@ extern "C" {
 #define USB_REQ_CONFIG_READ         0xC0    /* Read configuration */
 #define USB_REQ_CONFIG_WRITE        0xC1    /* Write configuration */
 #define USB_REQ_CONFIG_RESET        0xC2    /* Reset configuration to defaults */
+#define USB_REQ_GET_MODE            0xC3    /* Read active device mode (1 byte) */
+#define USB_REQ_SET_MODE            0xC4    /* Store device mode (wValue) and reset */
+#define USB_REQ_GET_TIMING          0xA1    /* Read report timing stats (wValue 1 = then clear) */
+#define USB_REQ_SET_SOF_OFFSET      0xA2    /* Set report load point, wValue = us after SOF */
+#define USB_REQ_SET_LATENCY_PROBE   0xA3    /* Vendor interface only: wValue 1 = send latency probes */
+#define USB_REQ_GET_JVS_TIMING      0xA4    /* Read JVS reply timing stats (wValue 1 = then clear) */
+#define USB_REQ_SET_JVS_TURNAROUND  0xA5    /* Set minimum JVS reply delay, wValue = us after request end */
+
+/* Vendor data interface framing */
+#define USB_RAW_HEADER_SIZE         4
+#define USB_RAW_PAYLOAD_SIZE        (HID_RAW_REPORT_SIZE - USB_RAW_HEADER_SIZE)
+
+#define USB_RAW_STATUS_OK           0x00    /* Command executed */
+#define USB_RAW_STATUS_ERROR        0x01    /* Bad parameter or flash error */
+#define USB_RAW_STATUS_UNKNOWN      0x02    /* Unknown command */
+
+#define USB_RAW_EVENT_LATENCY       0xE0    /* Unsolicited latency probe (UsbLatencyProbe_t) */
 
 /* Magic value for bootloader entry confirmation */
 #define BOOTLOADER_MAGIC            0xB007  /* wValue must match this */
@@ -58,6 +89,12 @@ uint8_t USB_ProcessVendorCommand(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
   */
 uint8_t USB_ProcessVendorData(USBD_HandleTypeDef *pdev);
 
+/**
+  * @brief  Run deferred vendor interface work (device reset)
+  * @note   Call from the main loop.
+  */
+void USB_Commands_Process(void);
+
 #ifdef __cplusplus
 }
 #endif
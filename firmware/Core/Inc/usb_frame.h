@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file           : usb_frame.h
+  * @brief          : USB frame phase tracker and SOF-synchronised report timing
+  ******************************************************************************
+  * @attention
+  *
+  * The host sends a Start Of Frame every 1 ms and polls the interrupt IN
+  * endpoint once per bInterval frames, usually right after the SOF. A
+  * report loaded as soon as an input changes can wait almost a full frame
+  * in the endpoint before it is collected.
+  *
+  * With USB_SOF_SYNC enabled the back ends only load a report once per
+  * frame, USB_SOF_LOAD_OFFSET_US after the SOF, i.e. just before the next
+  * poll. In INPUT_SCAN_TIMER mode TIM2 is re-phased on every SOF so a
+  * sample is taken USB_SOF_SAMPLE_LEAD_US before the load point.
+  *
+  * In both modes the age of every delivered report (newest input sample
+  * to IN completion) is measured and can be read with USB_REQ_GET_TIMING.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __USB_FRAME_H
+#define __USB_FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#ifndef USB_SOF_SYNC
+#define USB_SOF_SYNC            0       /* 1 = load reports at a fixed frame phase */
+#endif
+
+#ifndef USB_SOF_LOAD_OFFSET_US
+#define USB_SOF_LOAD_OFFSET_US  900     /* Report load point, us after SOF (< 1000) */
+#endif
+
+#ifndef USB_SOF_SAMPLE_LEAD_US
+#define USB_SOF_SAMPLE_LEAD_US  50      /* Timer sample taken this long before the load */
+#endif
+
+#define USB_FRAME_US            1000    /* Full-speed frame period */
+#define USB_SOF_TIMEOUT_US      3000    /* No SOF for this long: bus idle, load immediately */
+
+/* Report timing statistics (USB_REQ_GET_TIMING payload, little-endian) */
+typedef struct {
+    uint32_t reports;           /* Reports collected by the host */
+    uint16_t age_min_us;        /* Sample-to-poll age of those reports */
+    uint16_t age_avg_us;
+    uint16_t age_max_us;
+    uint16_t poll_phase_us;     /* Last IN completion, us after its SOF */
+    uint16_t load_offset_us;    /* Current load point, us after SOF */
+    uint8_t  sof_sync;          /* 1 if built with USB_SOF_SYNC */
+    uint8_t  reserved;
+} UsbFrameStats_t;
+
+/* Function prototypes */
+void UsbFrame_Init(void);
+bool UsbFrame_LoadDue(void);
+void UsbFrame_SetLoadOffset(uint16_t offset_us);
+void UsbFrame_ReportLoaded(uint8_t ep_index, uint32_t sample_time);
+void UsbFrame_ReportCollected(uint8_t ep_index);
+void UsbFrame_GetStats(UsbFrameStats_t* stats);
+void UsbFrame_ResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_FRAME_H */
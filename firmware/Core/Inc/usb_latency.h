@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file           : usb_latency.h
+  * @brief          : Per-report input latency probe on the vendor interface
+  ******************************************************************************
+  * @attention
+  *
+  * Optional (USB_LATENCY_PROBE) end-to-end latency instrumentation. For
+  * every HID report the host collects, a probe packet is queued on the
+  * vendor data interface with the inputs that changed in that report,
+  * the time of each input edge, the time the report was loaded into the
+  * endpoint and the time the host collected it. The game reports
+  * themselves are not changed, so the host sees the same descriptors
+  * with and without the probe.
+  *
+  * Edge and load times are the low 16 bits of Timebase_Micros(); the
+  * collection time is the full 32-bit value they are relative to (edges
+  * older than 65 ms are reported as 65 ms). With eager debouncing the
+  * edge time is the first sample that saw the transition; with delayed
+  * debouncing it is the sample that ended the stable period.
+  *
+  * The probe is compiled in with USB_LATENCY_PROBE and stays silent until
+  * the host enables it (USB_REQ_SET_LATENCY_PROBE). tools/latency_probe.py
+  * matches the packets with hidraw/evdev arrival times.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __USB_LATENCY_H
+#define __USB_LATENCY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "input_scan.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#ifndef USB_LATENCY_PROBE
+#define USB_LATENCY_PROBE       0       /* 1 = latency probe packets on the vendor interface */
+#endif
+
+#define USB_LATENCY_MAX_EDGES   13      /* Edges per packet (fills the 60-byte payload) */
+
+/* One input transition carried by a report */
+typedef struct {
+    uint16_t time;              /* Low 16 bits of Timebase_Micros() at the edge */
+    uint8_t bit;                /* Input vector bit */
+    uint8_t pressed;            /* Level after the edge (1 = pressed) */
+} UsbLatencyEdge_t;
+
+/* Probe packet payload (after the vendor interface header, little-endian) */
+typedef struct {
+    uint32_t collect_time;      /* Timebase_Micros() at IN completion */
+    uint16_t load_time;         /* Low 16 bits of Timebase_Micros() at endpoint load */
+    uint8_t slot;               /* Report slot (USBReport_Submit) */
+    uint8_t count;              /* Entries in edges[], plus USB_LATENCY_TRUNCATED */
+    UsbLatencyEdge_t edges[USB_LATENCY_MAX_EDGES];
+} UsbLatencyProbe_t;
+
+#define USB_LATENCY_TRUNCATED   0x80    /* Set in count when more inputs changed */
+
+/* Function prototypes */
+void UsbLatency_Init(void);
+void UsbLatency_SetEnabled(bool enabled);
+void UsbLatency_SetSlotInputs(uint8_t slot, InputVector_t inputs);
+void UsbLatency_Submit(uint8_t slot);
+void UsbLatency_Loaded(uint8_t slot, uint8_t ep_index, bool staged_report);
+void UsbLatency_Armed(uint8_t ep_index);
+void UsbLatency_Collected(uint8_t ep_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_LATENCY_H */
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file           : usb_report.h
+  * @brief          : Coalescing HID report scheduler
+  ******************************************************************************
+  * @attention
+  *
+  * USBD_HID_SendReport() refuses a report while the previous one is still
+  * in flight. Back ends submit their latest report into a slot (one per
+  * report ID) instead; a slot only keeps the newest state, and pending
+  * slots are sent round-robin from the DataIn completion interrupt, so
+  * every change reaches the host within one polling interval per pending
+  * slot and nothing is dropped or sent stale. The next report of a busy
+  * endpoint is staged in its second PMA buffer ahead of the DataIn. With
+  * HID_JOYSTICK_DUAL_EP every slot has its own endpoint and all of them go
+  * out in one frame.
+  *
+  * A back end can instead register a report builder and submit only the
+  * input vector of a slot (USBReport_SubmitInputs). The builder then
+  * writes the report straight into the endpoint's idle packet memory
+  * buffer when it is loaded, so no report copy is kept in RAM and change
+  * detection is a compare of the packed inputs.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __USB_REPORT_H
+#define __USB_REPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "usbd_hid.h"
+#include "input_scan.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define USB_REPORT_SLOTS        2               /* Report IDs in flight (joystick: P1 + P2) */
+#define USB_REPORT_MAX_SIZE     HID_EPIN_SIZE   /* Largest report on the IN endpoint */
+
+/* IN endpoint of a slot: one per slot with HID_JOYSTICK_DUAL_EP, else all share HID_EPIN_ADDR */
+#if HID_EPIN_COUNT > 1
+#define USB_REPORT_EP(slot)     (uint8_t)(HID_EPIN_ADDR + (slot))
+#else
+#define USB_REPORT_EP(slot)     HID_EPIN_ADDR
+#endif
+
+/* Writes the report of a slot into packet memory with USBD_PMA_WORD(),
+   returns its length. May run from the USB interrupt. */
+typedef uint16_t (*USBReport_Builder_t)(uint8_t slot, InputVector_t inputs, volatile uint16_t* pma);
+
+/* Function prototypes */
+void USBReport_Init(void);
+void USBReport_SetBuilder(USBReport_Builder_t builder, uint16_t len);
+void USBReport_Submit(uint8_t slot, const void* report, uint16_t len);
+void USBReport_SubmitInputs(uint8_t slot, InputVector_t inputs);
+void USBReport_Flush(void);
+bool USBReport_IsPending(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_REPORT_H */
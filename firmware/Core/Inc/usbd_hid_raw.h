@@ -1,25 +1,65 @@
+/**
+  ******************************************************************************
+  * @file    usbd_hid_raw.h
+  * @author  HIDO Project
+  * @brief   Vendor-defined HID interface (raw 64-byte data channel)
+  ******************************************************************************
+  * @attention
+  *
+  * A second HID interface with its own interrupt IN/OUT endpoints, present
+  * in every device mode after the game interface(s). It carries telemetry,
+  * configuration and diagnostics in fixed 64-byte reports, so host tools
+  * can talk to the device through hidraw / hidapi without detaching the
+  * kernel driver from the game interface and without EP0 transfers.
+  *
+  * The interface is not registered as a class of its own: the ST stack
+  * only holds one class, so USBD_HID builds the composite configuration
+  * and forwards this interface's requests and endpoints to USBD_HID_RAW.
+  *
+  * IN reports are queued (HID_RAW_TX_QUEUE_SIZE packets) and sent one per
+  * polling interval, up to 64 KB/s at bInterval 1. Received OUT reports
+  * are passed to USBD_HID_RAW_ReceiveCallback() in the USB interrupt,
+  * only while the IN queue has room for a reply: otherwise the OUT
+  * endpoint NAKs until the host has collected a queued report.
+  *
+  ******************************************************************************
+  */
+
 #ifndef __USBD_HID_RAW_H
 #define __USBD_HID_RAW_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #include <stdint.h>
+#include "usbd_def.h"
 
-#define HID_RAW_EPIN_ADDR      0x83U
-#define HID_RAW_EPOUT_ADDR     0x03U
-#define HID_RAW_EPIN_SIZE      64U
-#define HID_RAW_EPOUT_SIZE     64U
-#define HID_RAW_POLLING_INTERVAL 0x01U
+#define HID_RAW_EPIN_ADDR           0x83U
+#define HID_RAW_EPOUT_ADDR          0x03U
+#define HID_RAW_EPIN_SIZE           64U
+#define HID_RAW_EPOUT_SIZE          64U
+#define HID_RAW_POLLING_INTERVAL    0x01U   /* 1 ms: 64 KB/s each way */
 
+#define HID_RAW_REPORT_SIZE         64U     /* Every report is padded to this */
+#define HID_RAW_REPORT_DESC_SIZE    25U
+#define USB_HID_RAW_IF_DESC_SIZ     32U     /* Interface + HID + 2 endpoint descriptors */
 
-#define HID_RAW_REPORT_DESC_SIZE 0x41U
-extern const uint8_t HID_RAW_ReportDesc[HID_RAW_REPORT_DESC_SIZE];
+#define HID_RAW_TX_QUEUE_SIZE       8U      /* IN reports waiting for the host (power of 2) */
 
-#include "usbd_def.h"
+extern const uint8_t HID_RAW_ReportDesc[HID_RAW_REPORT_DESC_SIZE];
 
-// Dichiarazione della classe per la seconda interfaccia HID RAW
+/* Interface callbacks, called by USBD_HID for the raw interface */
 extern USBD_ClassTypeDef USBD_HID_RAW;
 
-// API di base per la RAW HID
+uint16_t USBD_HID_RAW_WriteIfDesc(uint8_t *desc, uint8_t intf);
 uint8_t USBD_HID_RAW_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len);
+uint8_t USBD_HID_RAW_TxIdle(void);
 uint8_t USBD_HID_RAW_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len);
+void USBD_HID_RAW_ReceiveCallback(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* __USBD_HID_RAW_H */
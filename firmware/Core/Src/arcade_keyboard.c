@@ -11,10 +11,16 @@
   */
 
 #include "arcade_keyboard.h"
+#include "input_core.h"
+#include "flash_config.h"
 #include "usbd_hid.h"
+#include "usb_report.h"
+#include "usb_frame.h"
+#include "usb_latency.h"
 #include "usb_device.h"
 #include "main.h"
 #include <string.h>
+#include <stddef.h>
 
 /* External USB Device handle */
 extern USBD_HandleTypeDef hUsbDeviceFS;
@@ -23,164 +29,116 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
 static NKRO_KeyboardReport_t current_report = {0};
 static NKRO_KeyboardReport_t previous_report = {0};
 
-/* Debouncing state */
-static uint32_t button_state[MAX_BUTTONS] = {0};      /* Current stable state */
-static uint32_t button_debounce[MAX_BUTTONS] = {0};   /* Debounce counter */
+/* Protocol used for the last report sent (boot or report) */
+static uint8_t previous_protocol = HID_PROTOCOL_REPORT;
 
-/* Button to keyboard mapping - Mapped to actual hardware pins from main.h
- * Player 1 (J6): 4 directions + 13 buttons = 17 inputs
- * Player 2 (J7): 4 directions + 13 buttons = 17 inputs
- * Total: 34 inputs
+/* Report byte and bit set by one input */
+typedef struct {
+    uint8_t offset;         /* Byte offset in NKRO_KeyboardReport_t */
+    uint8_t mask;           /* Bit in that byte */
+} KeyboardInputMap_t;
+
+/* Compiled pin mapping, rebuilt from the flash config by Arcade_ApplyConfig().
+ * Indexed by input vector bit so a report is a walk over the pressed bits.
  */
-static const ButtonMapping_t button_map[MAX_BUTTONS] = {
-    /* Player 1 Controls (indices 0-16) */
-    {P1_UP_GPIO_Port,    P1_UP_Pin,     0x52, true},  // P1 Up      -> Up Arrow
-    {P1_DOWN_GPIO_Port,  P1_DOWN_Pin,   0x51, true},  // P1 Down    -> Down Arrow
-    {P1_LEFT_GPIO_Port,  P1_LEFT_Pin,   0x50, true},  // P1 Left    -> Left Arrow
-    {P1_RIGHT_GPIO_Port, P1_RIGHT_Pin,  0x4F, true},  // P1 Right   -> Right Arrow
-    {P1_BTN1_GPIO_Port,  P1_BTN1_Pin,   0x1D, true},  // P1 Button1 -> Z
-    {P1_BTN2_GPIO_Port,  P1_BTN2_Pin,   0x1B, true},  // P1 Button2 -> X
-    {P1_BTN3_GPIO_Port,  P1_BTN3_Pin,   0x06, true},  // P1 Button3 -> C
-    {P1_BTN4_GPIO_Port,  P1_BTN4_Pin,   0x19, true},  // P1 Button4 -> V
-    {P1_BTN5_GPIO_Port,  P1_BTN5_Pin,   0x05, true},  // P1 Button5 -> B
-    {P1_BTN6_GPIO_Port,  P1_BTN6_Pin,   0x11, true},  // P1 Button6 -> N
-    {P1_BTN7_GPIO_Port,  P1_BTN7_Pin,   0x10, true},  // P1 Button7 -> M
-    {P1_BTN8_GPIO_Port,  P1_BTN8_Pin,   0x14, true},  // P1 Button8 -> Q
-    {P1_BTN9_GPIO_Port,  P1_BTN9_Pin,   0x1A, true},  // P1 Button9 -> W
-    {P1_BTN10_GPIO_Port, P1_BTN10_Pin,  0x08, true},  // P1 Button10 -> E
-    {P1_BTN11_GPIO_Port, P1_BTN11_Pin,  0x15, true},  // P1 Button11 -> R
-    {P1_BTN12_GPIO_Port, P1_BTN12_Pin,  0x17, true},  // P1 Button12 -> T
-    {P1_BTN13_GPIO_Port, P1_BTN13_Pin,  0x1C, true},  // P1 Button13 -> Y
-    
-    /* Player 2 Controls (indices 17-33) */
-    {P2_UP_GPIO_Port,    P2_UP_Pin,     0x3A, true},  // P2 Up      -> F1
-    {P2_DOWN_GPIO_Port,  P2_DOWN_Pin,   0x3B, true},  // P2 Down    -> F2
-    {P2_LEFT_GPIO_Port,  P2_LEFT_Pin,   0x3C, true},  // P2 Left    -> F3
-    {P2_RIGHT_GPIO_Port, P2_RIGHT_Pin,  0x3D, true},  // P2 Right   -> F4
-    {P2_BTN1_GPIO_Port,  P2_BTN1_Pin,   0x04, true},  // P2 Button1 -> A
-    {P2_BTN2_GPIO_Port,  P2_BTN2_Pin,   0x16, true},  // P2 Button2 -> S
-    {P2_BTN3_GPIO_Port,  P2_BTN3_Pin,   0x07, true},  // P2 Button3 -> D
-    {P2_BTN4_GPIO_Port,  P2_BTN4_Pin,   0x09, true},  // P2 Button4 -> F
-    {P2_BTN5_GPIO_Port,  P2_BTN5_Pin,   0x0A, true},  // P2 Button5 -> G
-    {P2_BTN6_GPIO_Port,  P2_BTN6_Pin,   0x0B, true},  // P2 Button6 -> H
-    {P2_BTN7_GPIO_Port,  P2_BTN7_Pin,   0x0D, true},  // P2 Button7 -> J
-    {P2_BTN8_GPIO_Port,  P2_BTN8_Pin,   0x0E, true},  // P2 Button8 -> K
-    {P2_BTN9_GPIO_Port,  P2_BTN9_Pin,   0x0F, true},  // P2 Button9 -> L
-    {P2_BTN10_GPIO_Port, P2_BTN10_Pin,  0x18, true},  // P2 Button10 -> U
-    {P2_BTN11_GPIO_Port, P2_BTN11_Pin,  0x0C, true},  // P2 Button11 -> I
-    {P2_BTN12_GPIO_Port, P2_BTN12_Pin,  0x12, true},  // P2 Button12 -> O
-    {P2_BTN13_GPIO_Port, P2_BTN13_Pin,  0x13, true},  // P2 Button13 -> P
-    
-    /* Unused slots */
-    {NULL, 0, 0, false},
-    {NULL, 0, 0, false},
-    {NULL, 0, 0, false},
-    {NULL, 0, 0, false},
-    {NULL, 0, 0, false},
-};
+static KeyboardInputMap_t key_by_bit[INPUT_COUNT];
+static InputVector_t mapped_mask = 0;           /* Bits with a keycode */
 
 /**
-  * @brief  Initialize arcade keyboard system
+  * @brief  Locate a keycode in the NKRO report
+  * @param  keycode: USB HID usage (0x04-0x7F or a modifier 0xE0-0xE7)
+  * @param  map: Receives the byte offset and bit mask
+  * @retval false if the usage is outside the report
   */
-void Arcade_Init(void)
+static bool Arcade_KeyToReportBit(uint8_t keycode, KeyboardInputMap_t* map)
 {
-    /* Clear all reports */
-    memset(&current_report, 0, sizeof(NKRO_KeyboardReport_t));
-    memset(&previous_report, 0, sizeof(NKRO_KeyboardReport_t));
+    if (keycode >= NKRO_MODIFIER_FIRST && keycode <= NKRO_MODIFIER_LAST) {
+        map->offset = offsetof(NKRO_KeyboardReport_t, modifiers);
+        map->mask = (uint8_t)(1U << (keycode - NKRO_MODIFIER_FIRST));
+        return true;
+    }
+    
+    if (keycode == 0 || keycode > NKRO_KEY_MAX) {
+        return false;
+    }
     
-    /* Initialize debounce state */
-    memset(button_state, 0, sizeof(button_state));
-    memset(button_debounce, 0, sizeof(button_debounce));
+    map->offset = (uint8_t)(offsetof(NKRO_KeyboardReport_t, keys) + (keycode >> 3));
+    map->mask = (uint8_t)(1U << (keycode & 7U));
+    return true;
 }
 
 /**
-  * @brief  Read button state with hardware debouncing
-  * @param  mapping: Button mapping configuration
-  * @retval true if button is pressed
+  * @brief  Compile the flash config into the per-bit lookup table
+  * @note   InputCore mapping callback, never runs while a report is built.
   */
-static inline bool ReadButton(const ButtonMapping_t* mapping)
+static void Arcade_ApplyConfig(void)
 {
-    if (mapping->port == NULL) return false;
+    memset(key_by_bit, 0, sizeof(key_by_bit));
+    mapped_mask = 0;
     
-    GPIO_PinState state = HAL_GPIO_ReadPin(mapping->port, mapping->pin);
+    KeyboardConfig_t* config = FlashConfig_GetKeyboard();
     
-    /* Active low: button pressed when pin is LOW */
-    if (mapping->active_low) {
-        return (state == GPIO_PIN_RESET);
-    } else {
-        return (state == GPIO_PIN_SET);
+    for (uint8_t player = 0; player < 2; player++) {
+        const KeyboardMapping_t* mapping = (player == 0) ? config->player1 : config->player2;
+        
+        /* Keys carry no direction: the stick is on the standard pins */
+        InputSocd_SetStandardStick(player, (InputSocdMode_t)config->socd_mode[player]);
+        InputCore_SetDebounce(player, config->debounce_mode[player]);
+        
+        for (uint8_t i = 0; i < MAX_PINS_PER_PLAYER; i++) {
+            uint8_t bit = InputScan_SilkBit(player, mapping[i].silk_pin);
+            if (bit >= INPUT_COUNT) continue;
+            if (!Arcade_KeyToReportBit(mapping[i].hid_keycode, &key_by_bit[bit])) continue;
+            
+            mapped_mask |= (InputVector_t)1 << bit;
+        }
     }
+    
+    UsbLatency_SetSlotInputs(0, mapped_mask);
 }
 
 /**
-  * @brief  Add key to 6KRO report
-  * @param  report: Keyboard report
-  * @param  keycode: USB HID keycode
+  * @brief  Initialize arcade keyboard system
+  * @note   The flash config must be loaded before this call.
   */
-static inline void AddKey(NKRO_KeyboardReport_t* report, uint8_t keycode)
+void Arcade_Init(void)
 {
-    /* Find first empty slot (0 = no key) */
-    for (int i = 0; i < 6; i++) {
-        if (report->keys[i] == 0) {
-            report->keys[i] = keycode;
-            return;
-        }
-        /* Avoid duplicates */
-        if (report->keys[i] == keycode) {
-            return;
-        }
-    }
-    /* All slots full - key will be ignored (6KRO limit) */
+    /* Clear all reports */
+    memset(&current_report, 0, sizeof(NKRO_KeyboardReport_t));
+    memset(&previous_report, 0, sizeof(NKRO_KeyboardReport_t));
+    
+    USBReport_Init();
+    InputCore_Init(Arcade_ApplyConfig);
 }
 
 /**
   * @brief  Process all arcade buttons and update report
+  * @note   Rebuilds the report only when the debounced state or the
+  *         mapping changed.
   */
 void Arcade_ProcessButtons(void)
 {
-    uint32_t current_time = HAL_GetTick();
-    bool p1_active = false;
-    bool p2_active = false;
+    if (!InputCore_Update()) {
+        return;
+    }
+    
+    InputVector_t pressed = InputCore_GetState() & mapped_mask;
     
     /* Clear current report */
     memset(&current_report, 0, sizeof(NKRO_KeyboardReport_t));
     current_report.report_id = 1;  /* Set Report ID */
     
-    /* Scan all buttons */
-    for (int i = 0; i < MAX_BUTTONS; i++) {
-        if (button_map[i].port == NULL) continue;
-        
-        bool pressed = ReadButton(&button_map[i]);
-        
-        /* Simple debouncing */
-        if (pressed != button_state[i]) {
-            if (button_debounce[i] == 0) {
-                button_debounce[i] = current_time;
-            } else if ((current_time - button_debounce[i]) >= DEBOUNCE_TIME_MS) {
-                /* State change confirmed after debounce time */
-                button_state[i] = pressed;
-                button_debounce[i] = 0;
-            }
-        } else {
-            button_debounce[i] = 0;
-        }
-        
-        /* Add pressed button to report (max 6 keys) */
-        if (button_state[i]) {
-            AddKey(&current_report, button_map[i].keycode);
-            
-            /* Track which player is active (0-16 = P1, 17-33 = P2) */
-            if (i < 17) {
-                p1_active = true;
-            } else if (i < 34) {
-                p2_active = true;
-            }
-        }
+    /* Only the pressed bits are visited; each one sets a single report bit */
+    uint8_t* report = (uint8_t*)&current_report;
+    InputVector_t remaining = pressed;
+    while (remaining) {
+        const KeyboardInputMap_t* key = &key_by_bit[InputScan_NextBit(&remaining)];
+        report[key->offset] |= key->mask;
     }
     
     /* LED Debug: LED1 for P1, LED2 for P2 */
-    HAL_GPIO_WritePin(LED1_GPIO_Port, LED1_Pin, p1_active ? GPIO_PIN_SET : GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED2_GPIO_Port, LED2_Pin, p2_active ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED1_GPIO_Port, LED1_Pin, (pressed & InputCore_GetPlayerMask(0)) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED2_GPIO_Port, LED2_Pin, (pressed & InputCore_GetPlayerMask(1)) ? GPIO_PIN_SET : GPIO_PIN_RESET);
 }
 
 /**
@@ -200,15 +158,68 @@ bool Arcade_UpdateKeyboardReport(NKRO_KeyboardReport_t* report)
     return false;
 }
 
+/**
+  * @brief  Convert the NKRO report to a boot protocol report
+  * @param  nkro: Source report
+  * @param  boot: Destination; with more than 6 keys held, every key slot
+  *         reads ErrorRollOver (phantom state) and only the modifiers are kept
+  */
+static void Arcade_BuildBootReport(const NKRO_KeyboardReport_t* nkro, Boot_KeyboardReport_t* boot)
+{
+    uint8_t count = 0;
+    
+    memset(boot, 0, sizeof(Boot_KeyboardReport_t));
+    boot->modifiers = nkro->modifiers;
+    
+    for (uint8_t i = 0; i < NKRO_KEY_BITMAP_SIZE; i++) {
+        uint8_t bits = nkro->keys[i];
+        while (bits != 0) {
+            uint8_t bit = (uint8_t)__builtin_ctz(bits);
+            bits &= (uint8_t)(bits - 1U);
+            if (count == BOOT_KEY_COUNT) {
+                memset(boot->keys, BOOT_KEY_ROLLOVER, BOOT_KEY_COUNT);
+                return;
+            }
+            boot->keys[count++] = (uint8_t)((i << 3) | bit);
+        }
+    }
+}
+
 /**
   * @brief  Send keyboard report via USB
+  * @note   Sends the 8-byte boot report instead when the host selected the
+  *         boot protocol (BIOS, UEFI setup).
   */
 void Arcade_SendKeyboardReport(void)
 {
     NKRO_KeyboardReport_t report;
+    uint8_t protocol;
+    
+    /* With USB_SOF_SYNC the report is only loaded once per frame, just before the poll */
+    if (!UsbFrame_LoadDue()) {
+        return;
+    }
     
-    if (Arcade_UpdateKeyboardReport(&report)) {
-        /* Report changed, send immediately to minimize latency */
-        USBD_HID_SendReport(&hUsbDeviceFS, (uint8_t*)&report, sizeof(NKRO_KeyboardReport_t));
+    protocol = USBD_HID_GetProtocol(&hUsbDeviceFS);
+    
+    /* A protocol switch changes the report format: resend the current state */
+    if (protocol != previous_protocol) {
+        previous_protocol = protocol;
+        memset(&previous_report, 0xFF, sizeof(NKRO_KeyboardReport_t));
+    }
+    
+    if (!Arcade_UpdateKeyboardReport(&report)) {
+        /* Nothing new; retry a report held back while unconfigured */
+        USBReport_Flush();
+        return;
+    }
+    
+    /* Report changed: queued as the latest state, sent as soon as the endpoint is free */
+    if (protocol == HID_PROTOCOL_BOOT) {
+        Boot_KeyboardReport_t boot;
+        Arcade_BuildBootReport(&report, &boot);
+        USBReport_Submit(0, &boot, sizeof(Boot_KeyboardReport_t));
+    } else {
+        USBReport_Submit(0, &report, sizeof(NKRO_KeyboardReport_t));
     }
 }
@@ -0,0 +1,92 @@
+/**
+  ******************************************************************************
+  * @file           : device_mode.c
+  * @brief          : Runtime device mode selection (keyboard / joystick / JVS)
+  ******************************************************************************
+  */
+
+#include "device_mode.h"
+#include "flash_config.h"
+#include "input_scan.h"
+
+/* Mode of this session, fixed at boot */
+static DeviceMode_t active_mode = DEVICE_MODE_DEFAULT;
+
+/* P1 silk pin held together with Start to select each mode */
+static const uint8_t chord_silk[DEVICE_MODE_COUNT] = {
+    0x00,   /* DEVICE_MODE_KEYBOARD */
+    0x01,   /* DEVICE_MODE_JOYSTICK */
+    0x02    /* DEVICE_MODE_JVS */
+};
+
+/**
+  * @brief  Read the boot chord
+  * @retval Selected mode, or DEVICE_MODE_COUNT if no chord is held
+  */
+static DeviceMode_t DeviceMode_ReadChord(void)
+{
+    uint8_t start = InputScan_SilkBit(0, DEVICE_MODE_CHORD_SILK);
+    InputVector_t held = InputScan_Read();
+
+    if (!InputScan_IsSet(held, start)) {
+        return DEVICE_MODE_COUNT;
+    }
+
+    /* Only inputs still pressed after the hold time count (no bounce, no noise) */
+    HAL_Delay(DEVICE_MODE_CHORD_HOLD_MS);
+    held &= InputScan_Read();
+
+    if (!InputScan_IsSet(held, start)) {
+        return DEVICE_MODE_COUNT;
+    }
+
+    for (uint8_t mode = 0; mode < DEVICE_MODE_COUNT; mode++) {
+        if (InputScan_IsSet(held, InputScan_SilkBit(0, chord_silk[mode]))) {
+            return (DeviceMode_t)mode;
+        }
+    }
+
+    return DEVICE_MODE_COUNT;
+}
+
+/**
+  * @brief  Select the mode of this session
+  * @note   Call after FlashConfig_Load() and InputScan_Init(), before
+  *         MX_USB_DEVICE_Init(). A boot chord is saved to flash so the
+  *         mode sticks without holding it again.
+  */
+void DeviceMode_Init(void)
+{
+    DeviceMode_t chord = DeviceMode_ReadChord();
+
+    active_mode = FlashConfig_GetDeviceMode();
+
+    if (chord < DEVICE_MODE_COUNT && chord != active_mode) {
+        active_mode = chord;
+        DeviceMode_Set(chord);
+    }
+}
+
+/**
+  * @brief  Mode of this session
+  */
+DeviceMode_t DeviceMode_Get(void)
+{
+    return active_mode;
+}
+
+/**
+  * @brief  Store a new mode in flash
+  * @param  mode: Mode to use from the next boot
+  * @retval HAL_OK if saved, HAL_ERROR on an invalid mode or flash error
+  * @note   The running session keeps its mode; reset to apply it.
+  */
+HAL_StatusTypeDef DeviceMode_Set(DeviceMode_t mode)
+{
+    if (mode >= DEVICE_MODE_COUNT) {
+        return HAL_ERROR;
+    }
+
+    FlashConfig_SetDeviceMode(mode);
+    return FlashConfig_Save();
+}
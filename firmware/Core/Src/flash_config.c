@@ -6,14 +6,11 @@
   */
 
 #include "flash_config.h"
+#include "input_core.h"
 #include <string.h>
 
 /* Private variables */
-#ifdef USE_KEYBOARD_MODE
-static KeyboardConfig_t g_config;
-#else
-static JoystickConfig_t g_config;
-#endif
+static FlashConfigStore_t g_store;
 
 /* CRC32 lookup table */
 static const uint32_t crc32_table[256] = {
@@ -69,58 +66,98 @@ static uint32_t Calculate_CRC32(const uint8_t *data, uint32_t length)
 }
 
 /**
-  * @brief  Load default configuration
+  * @brief  CRC32 of a config part (everything but its trailing crc32 field)
   */
-void FlashConfig_LoadDefaults(void)
+#define CONFIG_PART_CRC(part)   Calculate_CRC32((const uint8_t*)&(part), sizeof(part) - 4)
+
+/**
+  * @brief  Check the header and CRC of a mapping part (keyboard or joystick)
+  */
+#define CONFIG_MAPPING_VALID(part) \
+    ((part).magic == CONFIG_MAGIC && (part).version == CONFIG_VERSION && (part).crc32 == CONFIG_PART_CRC(part))
+
+/**
+  * @brief  Load the default keyboard mapping
+  */
+static void FlashConfig_LoadKeyboardDefaults(void)
 {
-    g_config.magic = CONFIG_MAGIC;
-    g_config.version = CONFIG_VERSION;
+    KeyboardConfig_t* config = &g_store.keyboard;
     
-#ifdef USE_KEYBOARD_MODE
-    /* Default keyboard mapping for Player 1 (WASD + keys) */
+    config->magic = CONFIG_MAGIC;
+    config->version = CONFIG_VERSION;
+    config->poll_interval_ms = POLL_INTERVAL_DEFAULT_MS;
+    memset(config->socd_mode, SOCD_OFF, sizeof(config->socd_mode));
+    config->reserved = 0;
+    memset(config->debounce_mode, DEBOUNCE_PIN_DEFAULT, sizeof(config->debounce_mode));
+    memset(config->reserved2, 0, sizeof(config->reserved2));
+    
+    /* Default keyboard mapping for Player 1 (silk 0-C: buttons, D-10: R/L/D/U) */
     const uint8_t p1_defaults[17] = {
-        0x04, 0x16, 0x1A, 0x08,  /* 0-3: A, S, W, D */
-        0x14, 0x1B, 0x06, 0x19,  /* 4-7: Q, X, C, V */
-        0x1E, 0x1F, 0x20, 0x21,  /* 8-11: 1, 2, 3, 4 */
-        0x22, 0x23, 0x24, 0x25,  /* 12-15: 5, 6, 7, 8 */
-        0x26                      /* 16: 9 */
+        0x1D, 0x1B, 0x06, 0x19,  /* 0-3: Z, X, C, V */
+        0x05, 0x11, 0x10, 0x14,  /* 4-7: B, N, M, Q */
+        0x1A, 0x08, 0x15, 0x17,  /* 8-B: W, E, R, T */
+        0x1C, 0x4F, 0x50, 0x51,  /* C-F: Y, RIGHT, LEFT, DOWN */
+        0x52                      /* 10: UP */
     };
     
-    /* Default keyboard mapping for Player 2 (Arrow keys + numpad) */
+    /* Default keyboard mapping for Player 2 (letters + F1-F4 for directions) */
     const uint8_t p2_defaults[17] = {
-        0x50, 0x51, 0x52, 0x4F,  /* 0-3: LEFT, DOWN, UP, RIGHT */
-        0x59, 0x5A, 0x5B, 0x5C,  /* 4-7: Numpad 1, 2, 3, 4 */
-        0x5D, 0x5E, 0x5F, 0x60,  /* 8-11: Numpad 5, 6, 7, 8 */
-        0x61, 0x62, 0x63, 0x54,  /* 12-15: Numpad 9, 0, ., / */
-        0x55                      /* 16: Numpad * */
+        0x04, 0x16, 0x07, 0x12,  /* 0-3: A, S, D, O */
+        0x13, 0x09, 0x0A, 0x0B,  /* 4-7: P, F, G, H */
+        0x0D, 0x0E, 0x0F, 0x18,  /* 8-B: J, K, L, U */
+        0x0C, 0x3D, 0x3C, 0x3B,  /* C-F: I, F4, F3, F2 */
+        0x3A                      /* 10: F1 */
     };
     
-    const char *p1_names[17] = {"A", "S", "W", "D", "Q", "X", "C", "V", 
-                                 "1", "2", "3", "4", "5", "6", "7", "8", "9"};
-    const char *p2_names[17] = {"LEFT", "DOWN", "UP", "RIGHT", "Num1", "Num2", 
-                                 "Num3", "Num4", "Num5", "Num6", "Num7", "Num8",
-                                 "Num9", "Num0", "Num.", "Num/", "Num*"};
+    const char *p1_names[17] = {"Z", "X", "C", "V", "B", "N", "M", "Q", "W",
+                                 "E", "R", "T", "Y", "RIGHT", "LEFT", "DOWN", "UP"};
+    const char *p2_names[17] = {"A", "S", "D", "O", "P", "F", "G", "H", "J",
+                                 "K", "L", "U", "I", "F4", "F3", "F2", "F1"};
     
     for (int i = 0; i < MAX_PINS_PER_PLAYER; i++) {
-        g_config.player1[i].silk_pin = i;
-        g_config.player1[i].hid_keycode = p1_defaults[i];
-        strncpy(g_config.player1[i].key_name, p1_names[i], 15);
-        g_config.player1[i].key_name[15] = '\0';
+        config->player1[i].silk_pin = i;
+        config->player1[i].hid_keycode = p1_defaults[i];
+        strncpy(config->player1[i].key_name, p1_names[i], 15);
+        config->player1[i].key_name[15] = '\0';
         
-        g_config.player2[i].silk_pin = i;
-        g_config.player2[i].hid_keycode = p2_defaults[i];
-        strncpy(g_config.player2[i].key_name, p2_names[i], 15);
-        g_config.player2[i].key_name[15] = '\0';
+        config->player2[i].silk_pin = i;
+        config->player2[i].hid_keycode = p2_defaults[i];
+        strncpy(config->player2[i].key_name, p2_names[i], 15);
+        config->player2[i].key_name[15] = '\0';
     }
     
-#else /* USE_JOYSTICK_MODE */
-    /* Default joystick mapping */
+    config->crc32 = CONFIG_PART_CRC(*config);
+}
+
+/**
+  * @brief  Load the default joystick mapping
+  */
+static void FlashConfig_LoadJoystickDefaults(void)
+{
+    JoystickConfig_t* config = &g_store.joystick;
+    
+    config->magic = CONFIG_MAGIC;
+    config->version = CONFIG_VERSION;
+    config->poll_interval_ms = POLL_INTERVAL_DEFAULT_MS;
+    memset(config->socd_mode, SOCD_OFF, sizeof(config->socd_mode));
+    config->reserved = 0;
+    memset(config->debounce_mode, DEBOUNCE_PIN_DEFAULT, sizeof(config->debounce_mode));
+    memset(config->reserved2, 0, sizeof(config->reserved2));
+    
+    /* Default joystick mapping (silk 0-C: buttons, D-10: R/L/D/U) */
     const uint8_t p1_defaults[17] = {
-        JOY_FUNC_AXIS_LEFT, JOY_FUNC_AXIS_DOWN, JOY_FUNC_AXIS_UP, JOY_FUNC_AXIS_RIGHT,
+        JOY_FUNC_BUTTON_1, JOY_FUNC_BUTTON_2, JOY_FUNC_BUTTON_4, JOY_FUNC_BUTTON_3,
+        JOY_FUNC_BUTTON_5, JOY_FUNC_BUTTON_6, JOY_FUNC_BUTTON_7, JOY_FUNC_BUTTON_8,
+        JOY_FUNC_BUTTON_9, JOY_FUNC_BUTTON_10, JOY_FUNC_BUTTON_11, JOY_FUNC_BUTTON_12,
+        JOY_FUNC_BUTTON_13, JOY_FUNC_AXIS_RIGHT, JOY_FUNC_AXIS_LEFT, JOY_FUNC_AXIS_DOWN,
+        JOY_FUNC_AXIS_UP
+    };
+    const uint8_t p2_defaults[17] = {
         JOY_FUNC_BUTTON_1, JOY_FUNC_BUTTON_2, JOY_FUNC_BUTTON_3, JOY_FUNC_BUTTON_4,
         JOY_FUNC_BUTTON_5, JOY_FUNC_BUTTON_6, JOY_FUNC_BUTTON_7, JOY_FUNC_BUTTON_8,
         JOY_FUNC_BUTTON_9, JOY_FUNC_BUTTON_10, JOY_FUNC_BUTTON_11, JOY_FUNC_BUTTON_12,
-        JOY_FUNC_BUTTON_13
+        JOY_FUNC_BUTTON_13, JOY_FUNC_AXIS_RIGHT, JOY_FUNC_AXIS_LEFT, JOY_FUNC_AXIS_DOWN,
+        JOY_FUNC_AXIS_UP
     };
     
     const char *func_names[19] = {
@@ -131,71 +168,97 @@ void FlashConfig_LoadDefaults(void)
     
     for (int i = 0; i < MAX_PINS_PER_PLAYER; i++) {
         /* Player 1 */
-        g_config.player1[i].silk_pin = i;
-        g_config.player1[i].joy_function = p1_defaults[i];
-        strncpy(g_config.player1[i].func_name, func_names[p1_defaults[i]], 15);
-        g_config.player1[i].func_name[15] = '\0';
+        config->player1[i].silk_pin = i;
+        config->player1[i].joy_function = p1_defaults[i];
+        strncpy(config->player1[i].func_name, func_names[p1_defaults[i]], 15);
+        config->player1[i].func_name[15] = '\0';
         
-        /* Player 2 (same as Player 1) */
-        g_config.player2[i].silk_pin = i;
-        g_config.player2[i].joy_function = p1_defaults[i];
-        strncpy(g_config.player2[i].func_name, func_names[p1_defaults[i]], 15);
-        g_config.player2[i].func_name[15] = '\0';
+        /* Player 2 */
+        config->player2[i].silk_pin = i;
+        config->player2[i].joy_function = p2_defaults[i];
+        strncpy(config->player2[i].func_name, func_names[p2_defaults[i]], 15);
+        config->player2[i].func_name[15] = '\0';
     }
-#endif
     
-    /* Calculate CRC */
-    g_config.crc32 = Calculate_CRC32((uint8_t*)&g_config, sizeof(g_config) - 4);
+    config->crc32 = CONFIG_PART_CRC(*config);
+}
+
+/**
+  * @brief  Load the default device mode (build-time USE_*_MODE)
+  */
+static void FlashConfig_LoadModeDefaults(void)
+{
+    g_store.mode.magic = CONFIG_MAGIC;
+    g_store.mode.device_mode = DEVICE_MODE_DEFAULT;
+    memset(g_store.mode.reserved, 0, sizeof(g_store.mode.reserved));
+    g_store.mode.crc32 = CONFIG_PART_CRC(g_store.mode);
+}
+
+/**
+  * @brief  Load default configuration (every mode and the device mode)
+  */
+void FlashConfig_LoadDefaults(void)
+{
+    FlashConfig_LoadKeyboardDefaults();
+    FlashConfig_LoadJoystickDefaults();
+    FlashConfig_LoadModeDefaults();
+}
+
+/**
+  * @brief  Check the header and CRC of the device mode record
+  */
+static uint8_t FlashConfig_IsModeValid(void)
+{
+    return (g_store.mode.magic == CONFIG_MAGIC) &&
+           (g_store.mode.device_mode < DEVICE_MODE_COUNT) &&
+           (g_store.mode.crc32 == CONFIG_PART_CRC(g_store.mode));
 }
 
 /**
   * @brief  Validate configuration from flash
-  * @retval 1 if valid, 0 if invalid
+  * @retval 1 if every part is valid, 0 otherwise
   */
 uint8_t FlashConfig_IsValid(void)
 {
-    /* Check magic number */
-    if (g_config.magic != CONFIG_MAGIC) {
-        return 0;
-    }
-    
-    /* Check version */
-    if (g_config.version != CONFIG_VERSION) {
-        return 0;
-    }
-    
-    /* Verify CRC32 */
-    uint32_t calculated_crc = Calculate_CRC32((uint8_t*)&g_config, sizeof(g_config) - 4);
-    if (calculated_crc != g_config.crc32) {
-        return 0;
-    }
-    
-    return 1;
+    return CONFIG_MAPPING_VALID(g_store.keyboard) &&
+           CONFIG_MAPPING_VALID(g_store.joystick) &&
+           FlashConfig_IsModeValid();
 }
 
 /**
   * @brief  Load configuration from flash
-  * @retval HAL_OK if successful, HAL_ERROR otherwise
+  * @retval HAL_OK if successful, HAL_ERROR if any part was invalid (that
+  *         part now holds its defaults and should be saved)
   */
 HAL_StatusTypeDef FlashConfig_Load(void)
 {
     /* Read configuration from flash */
     uint32_t *flash_ptr = (uint32_t*)CONFIG_FLASH_ADDR;
-    uint32_t *config_ptr = (uint32_t*)&g_config;
-    uint32_t words = sizeof(g_config) / 4;
+    uint32_t *config_ptr = (uint32_t*)&g_store;
+    uint32_t words = sizeof(g_store) / 4;
+    HAL_StatusTypeDef status = HAL_OK;
     
     for (uint32_t i = 0; i < words; i++) {
         config_ptr[i] = flash_ptr[i];
     }
     
-    /* Validate configuration */
-    if (!FlashConfig_IsValid()) {
-        /* Invalid configuration, load defaults */
-        FlashConfig_LoadDefaults();
-        return HAL_ERROR;
+    /* Validate each part; invalid parts load their defaults */
+    if (!CONFIG_MAPPING_VALID(g_store.keyboard)) {
+        FlashConfig_LoadKeyboardDefaults();
+        status = HAL_ERROR;
     }
     
-    return HAL_OK;
+    if (!CONFIG_MAPPING_VALID(g_store.joystick)) {
+        FlashConfig_LoadJoystickDefaults();
+        status = HAL_ERROR;
+    }
+    
+    if (!FlashConfig_IsModeValid()) {
+        FlashConfig_LoadModeDefaults();
+        status = HAL_ERROR;
+    }
+    
+    return status;
 }
 
 /**
@@ -206,8 +269,10 @@ HAL_StatusTypeDef FlashConfig_Save(void)
 {
     HAL_StatusTypeDef status;
     
-    /* Update CRC32 */
-    g_config.crc32 = Calculate_CRC32((uint8_t*)&g_config, sizeof(g_config) - 4);
+    /* Update CRC32 of every part */
+    g_store.keyboard.crc32 = CONFIG_PART_CRC(g_store.keyboard);
+    g_store.joystick.crc32 = CONFIG_PART_CRC(g_store.joystick);
+    g_store.mode.crc32 = CONFIG_PART_CRC(g_store.mode);
     
     /* Unlock flash */
     HAL_FLASH_Unlock();
@@ -227,8 +292,8 @@ HAL_StatusTypeDef FlashConfig_Save(void)
     }
     
     /* Write configuration */
-    uint32_t *config_ptr = (uint32_t*)&g_config;
-    uint32_t words = sizeof(g_config) / 4;
+    uint32_t *config_ptr = (uint32_t*)&g_store;
+    uint32_t words = sizeof(g_store) / 4;
     uint32_t flash_addr = CONFIG_FLASH_ADDR;
     
     for (uint32_t i = 0; i < words; i++) {
@@ -247,24 +312,67 @@ HAL_StatusTypeDef FlashConfig_Save(void)
 }
 
 /**
-  * @brief  Reset configuration to defaults and save
+  * @brief  Get the configured USB polling interval
+  * @retval bInterval in ms from the active mode's config; unsupported
+  *         values fall back to the default
+  */
+uint8_t FlashConfig_GetPollInterval(void)
+{
+    uint8_t interval = (DeviceMode_Get() == DEVICE_MODE_KEYBOARD) ?
+                       g_store.keyboard.poll_interval_ms : g_store.joystick.poll_interval_ms;
+    
+    switch (interval) {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case 10:
+            return interval;
+        default:
+            return POLL_INTERVAL_DEFAULT_MS;
+    }
+}
+
+/**
+  * @brief  Get the stored device mode
+  */
+DeviceMode_t FlashConfig_GetDeviceMode(void)
+{
+    return (DeviceMode_t)g_store.mode.device_mode;
+}
+
+/**
+  * @brief  Set the stored device mode (RAM copy, call FlashConfig_Save())
+  */
+void FlashConfig_SetDeviceMode(DeviceMode_t mode)
+{
+    g_store.mode.device_mode = (uint8_t)mode;
+}
+
+/**
+  * @brief  Reset every mapping to defaults and save
+  * @note   The device mode is kept, so a reset never switches the mode.
   * @retval HAL_OK if successful, HAL_ERROR otherwise
   */
 HAL_StatusTypeDef FlashConfig_Reset(void)
 {
-    FlashConfig_LoadDefaults();
+    FlashConfig_LoadKeyboardDefaults();
+    FlashConfig_LoadJoystickDefaults();
     return FlashConfig_Save();
 }
 
 /**
-  * @brief  Get pointer to current configuration
-  * @retval Pointer to configuration structure
+  * @brief  Get pointer to the keyboard mode configuration
+  */
+KeyboardConfig_t* FlashConfig_GetKeyboard(void)
+{
+    return &g_store.keyboard;
+}
+
+/**
+  * @brief  Get pointer to the joystick (and JVS) mode configuration
   */
-#ifdef USE_KEYBOARD_MODE
-KeyboardConfig_t* FlashConfig_Get(void)
-#else
-JoystickConfig_t* FlashConfig_Get(void)
-#endif
+JoystickConfig_t* FlashConfig_GetJoystick(void)
 {
-    return &g_config;
+    return &g_store.joystick;
 }
@@ -22,6 +22,7 @@
 #include "gpio.h"
 
 /* USER CODE BEGIN 0 */
+#include "input_edge.h"
 
 /* USER CODE END 0 */
 
@@ -156,4 +157,12 @@ void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 2 */
 
+/**
+  * @brief  EXTI line detection callback: button edge capture
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  InputEdge_IRQ(GPIO_Pin);
+}
+
 /* USER CODE END 2 */
@@ -10,6 +10,7 @@
 
 #include "main.h"
 #include "usart.h"
+#include "timebase.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -114,11 +115,10 @@ void GPIO_TestAllPins(void)
 void GPIO_ContinuousTest(void)
 {
     static uint32_t last_test_time = 0;
-    uint32_t current_time = HAL_GetTick();
     
     /* Test ogni 500ms */
-    if ((current_time - last_test_time) >= 500) {
+    if (Timebase_Elapsed(last_test_time) >= 500000U) {
         GPIO_TestAllPins();
-        last_test_time = current_time;
+        last_test_time = Timebase_Micros();
     }
 }
@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file           : input_core.c
+  * @brief          : Input subsystem shared by all output modes
+  ******************************************************************************
+  * @attention
+  *
+  * Every mode calls InputCore_Update() once per main loop pass: it takes
+  * the poll-mode snapshot, drains the sample queue through the vector
+  * debounce and SOCD cleaning and applies a pending mapping reload. The
+  * return value tells the back end whether its report has to be rebuilt.
+  *
+  ******************************************************************************
+  */
+
+#include "input_core.h"
+
+static InputCore_MapCallback_t map_callback = NULL;
+static InputVector_t player_mask[2];
+static uint32_t sample_time = 0;    /* Timebase_Micros() of the newest debounced sample */
+static uint32_t edge_time[INPUT_COUNT];     /* Sample time of each input's last change */
+static InputVector_t state = 0;     /* Debounced and SOCD-cleaned vector */
+static InputVector_t eager_mask = 0;    /* Inputs on eager debounce */
+
+/* Set from the USB interrupt when the host writes a new config */
+static volatile bool reload_pending = false;
+
+/**
+  * @brief  Initialize debounce and compile the back end mapping
+  * @param  apply_config: Mapping compiler of the active mode, or NULL
+  * @note   Call after InputScan_Init() and FlashConfig_Load().
+  */
+void InputCore_Init(InputCore_MapCallback_t apply_config)
+{
+    /* All inputs start released */
+    InputDebounce_Init(DEBOUNCE_TIME_US, DEBOUNCE_LOCKOUT_US, 0);
+    
+    /* Debounce does not depend on the mapping: every scanned input is filtered */
+    InputVector_t all = 0;
+    for (uint8_t player = 0; player < 2; player++) {
+        player_mask[player] = 0;
+        for (uint8_t silk = 0; silk < INPUT_PINS_PER_PLAYER; silk++) {
+            uint8_t bit = InputScan_SilkBit(player, silk);
+            if (bit == INPUT_BIT_NONE) continue;
+            player_mask[player] |= (InputVector_t)1 << bit;
+        }
+        all |= player_mask[player];
+    }
+    eager_mask = (DEBOUNCE_DEFAULT == DEBOUNCE_EAGER) ? all : 0;
+    InputDebounce_SetEager(eager_mask);
+    
+    /* SOCD stays off unless the mapping callback configures it */
+    InputSocd_Init();
+    state = 0;
+    
+    map_callback = apply_config;
+    reload_pending = false;
+    if (map_callback != NULL) {
+        map_callback();
+    }
+}
+
+/**
+  * @brief  Run the input pipeline
+  * @retval true if the cleaned input state or the mapping changed
+  */
+bool InputCore_Update(void)
+{
+    InputSample_t sample;
+    bool changed = false;
+    
+    /* New mapping from the host: recompile before building the next report */
+    if (reload_pending) {
+        reload_pending = false;
+        if (map_callback != NULL) {
+            /* Report builders may read the tables from the USB interrupt */
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            map_callback();
+            __set_PRIMASK(primask);
+        }
+        state = InputSocd_Apply(InputDebounce_GetState());
+        changed = true;
+    }
+    
+    /* Poll mode takes its snapshot here; timer and DMA modes are already sampling */
+    InputScan_Poll();
+    
+    while (InputScan_GetSample(&sample)) {
+        if (InputDebounce_Update(&sample)) {
+            InputVector_t cleaned = InputSocd_Apply(InputDebounce_GetState());
+            InputVector_t flipped = state ^ cleaned;
+            state = cleaned;
+            changed |= (flipped != 0);
+            while (flipped) {
+                edge_time[InputScan_NextBit(&flipped)] = sample.time;
+            }
+        }
+        sample_time = sample.time;
+    }
+    
+    return changed;
+}
+
+/**
+  * @brief  Debounced input vector after SOCD cleaning (1 = pressed)
+  */
+InputVector_t InputCore_GetState(void)
+{
+    return state;
+}
+
+/**
+  * @brief  Time the newest sample was taken (Timebase_Micros())
+  * @note   The state returned by InputCore_GetState() is this old.
+  */
+uint32_t InputCore_GetSampleTime(void)
+{
+    return sample_time;
+}
+
+/**
+  * @brief  Time of the last change of one input in InputCore_GetState() (Timebase_Micros())
+  * @param  bit: Input vector bit
+  */
+uint32_t InputCore_GetEdgeTime(uint8_t bit)
+{
+    return (bit < INPUT_COUNT) ? edge_time[bit] : 0;
+}
+
+/**
+  * @brief  Input vector bits wired to one player connector
+  * @param  player: 0 = Player 1 (J6), 1 = Player 2 (J7)
+  */
+InputVector_t InputCore_GetPlayerMask(uint8_t player)
+{
+    return (player < 2) ? player_mask[player] : 0;
+}
+
+/**
+  * @brief  Select the debounce algorithm of one player's pins
+  * @param  player: 0 = Player 1, 1 = Player 2
+  * @param  modes: INPUT_PINS_PER_PLAYER entries indexed by silk pin:
+  *         DEBOUNCE_DELAYED, DEBOUNCE_EAGER, or DEBOUNCE_PIN_DEFAULT
+  *         (any other value) for DEBOUNCE_DEFAULT
+  * @note   Called by the back end mapping callback.
+  */
+void InputCore_SetDebounce(uint8_t player, const uint8_t* modes)
+{
+    if (player >= 2) {
+        return;
+    }
+    
+    for (uint8_t silk = 0; silk < INPUT_PINS_PER_PLAYER; silk++) {
+        uint8_t bit = InputScan_SilkBit(player, silk);
+        if (bit == INPUT_BIT_NONE) continue;
+        
+        uint8_t mode = modes[silk];
+        if (mode != DEBOUNCE_DELAYED && mode != DEBOUNCE_EAGER) {
+            mode = DEBOUNCE_DEFAULT;
+        }
+        
+        if (mode == DEBOUNCE_EAGER) {
+            eager_mask |= (InputVector_t)1 << bit;
+        } else {
+            eager_mask &= ~((InputVector_t)1 << bit);
+        }
+    }
+    
+    InputDebounce_SetEager(eager_mask);
+}
+
+/**
+  * @brief  Request a rebuild of the back end mapping
+  * @note   Safe to call from interrupt context; the callback runs from the
+  *         next InputCore_Update() call.
+  */
+void InputCore_ReloadConfig(void)
+{
+    reload_pending = true;
+}
@@ -0,0 +1,200 @@
+/**
+  ******************************************************************************
+  * @file           : input_debounce.c
+  * @brief          : Bit-parallel vertical-counter debounce
+  ******************************************************************************
+  * @attention
+  *
+  * counter[i] holds bit i of a per-input count of consecutive ticks on which
+  * the raw level differed from the debounced state. Inputs that agree with
+  * the state are cleared; inputs whose count reaches the threshold toggle
+  * their state and restart from zero.
+  *
+  * Eager inputs use lockout[i] instead: a non-zero count means the input is
+  * locked. It is set to 1 when the input toggles, advances every tick and is
+  * cleared once the lockout has passed.
+  *
+  ******************************************************************************
+  */
+
+#include "input_debounce.h"
+#include "timebase.h"
+#include <string.h>
+
+static InputVector_t counter[INPUT_DEBOUNCE_PLANES];
+static InputVector_t lockout[INPUT_DEBOUNCE_PLANES];
+static InputVector_t eager = 0;         /* Inputs using the eager algorithm */
+static InputVector_t state = 0;         /* Debounced vector */
+static InputVector_t raw = 0;           /* Level held since the last tick */
+static uint32_t last_tick = 0;         /* Sample time of the last tick boundary */
+static uint8_t threshold = 1;
+static uint8_t lockout_end = 2;         /* Lockout count at which the lock expires */
+
+/**
+  * @brief  Ripple-increment the counters selected by mask, clear all others
+  */
+static void Increment(InputVector_t planes[INPUT_DEBOUNCE_PLANES], InputVector_t mask)
+{
+    InputVector_t carry = mask;
+
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        InputVector_t next_carry = planes[i] & carry;
+        planes[i] = (planes[i] ^ carry) & mask;
+        carry = next_carry;
+    }
+}
+
+/**
+  * @brief  Inputs whose counter equals value
+  */
+static InputVector_t Match(const InputVector_t planes[INPUT_DEBOUNCE_PLANES], InputVector_t mask, uint8_t value)
+{
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        mask &= ((value >> i) & 1U) ? planes[i] : ~planes[i];
+    }
+    return mask;
+}
+
+/**
+  * @brief  Report eager edges on unlocked inputs and lock them
+  */
+static void Fire(void)
+{
+    InputVector_t locked = 0;
+
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        locked |= lockout[i];
+    }
+
+    InputVector_t fire = (raw ^ state) & eager & ~locked;
+    state ^= fire;
+    lockout[0] |= fire;
+}
+
+/**
+  * @brief  Advance every counter by one tick
+  */
+static void Step(void)
+{
+    /* Delayed inputs: count ticks spent at a different level */
+    InputVector_t delta = (raw ^ state) & ~eager;
+    Increment(counter, delta);
+
+    InputVector_t done = Match(counter, delta, threshold);
+    state ^= done;
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        counter[i] &= ~done;
+    }
+
+    /* Eager inputs: age the lockouts, release expired ones */
+    InputVector_t locked = 0;
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        locked |= lockout[i];
+    }
+    Increment(lockout, locked);
+
+    InputVector_t expired = Match(lockout, locked, lockout_end);
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        lockout[i] &= ~expired;
+    }
+
+    /* A change that happened during the lockout is reported right away */
+    Fire();
+}
+
+/**
+  * @brief  Convert a window to ticks, rounding up (1..INPUT_DEBOUNCE_MAX_TICKS)
+  */
+static uint8_t ToTicks(uint32_t us)
+{
+    uint32_t ticks = (us + INPUT_DEBOUNCE_TICK_US - 1U) / INPUT_DEBOUNCE_TICK_US;
+
+    if (ticks == 0) {
+        ticks = 1;
+    } else if (ticks > INPUT_DEBOUNCE_MAX_TICKS) {
+        ticks = INPUT_DEBOUNCE_MAX_TICKS;
+    }
+    return (uint8_t)ticks;
+}
+
+/**
+  * @brief  Reset the filter
+  * @param  debounce_us: Delayed inputs: how long a new level must be held
+  *         (up to INPUT_DEBOUNCE_MAX_US)
+  * @param  lockout_us: Eager inputs: how long further edges are ignored
+  *         after a change (up to INPUT_DEBOUNCE_MAX_US)
+  * @param  initial: Debounced state to start from
+  * @note   Every input starts delayed; see InputDebounce_SetEager().
+  */
+void InputDebounce_Init(uint32_t debounce_us, uint32_t lockout_us, InputVector_t initial)
+{
+    memset(counter, 0, sizeof(counter));
+    memset(lockout, 0, sizeof(lockout));
+    eager = 0;
+    threshold = ToTicks(debounce_us);
+    lockout_end = ToTicks(lockout_us) + 1U;
+    state = initial;
+    raw = initial;
+    last_tick = Timebase_Micros();
+}
+
+/**
+  * @brief  Select the eager algorithm for some inputs
+  * @param  mask: Inputs that use eager debounce, all others use delayed
+  */
+void InputDebounce_SetEager(InputVector_t mask)
+{
+    /* Drop counts that belong to the other algorithm */
+    for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+        counter[i] &= ~mask;
+        lockout[i] &= mask;
+    }
+    eager = mask;
+}
+
+/**
+  * @brief  Feed one sample into the filter
+  * @param  sample: Timestamped input snapshot
+  * @retval true if the debounced state changed
+  */
+bool InputDebounce_Update(const InputSample_t* sample)
+{
+    InputVector_t previous = state;
+    int32_t elapsed = Timebase_Diff(sample->time, last_tick);
+
+    if (elapsed >= INPUT_DEBOUNCE_TICK_US) {
+        uint32_t ticks = (uint32_t)elapsed / INPUT_DEBOUNCE_TICK_US;
+
+        /* The level read by the previous sample was held until now */
+        bool busy = (raw ^ state) != 0;
+        for (uint8_t i = 0; i < INPUT_DEBOUNCE_PLANES; i++) {
+            busy |= lockout[i] != 0;
+        }
+
+        if (busy) {
+            uint32_t limit = (threshold > lockout_end) ? threshold : lockout_end;
+            uint32_t steps = (ticks < limit) ? ticks : limit;
+            while (steps--) {
+                Step();
+            }
+        } else {
+            memset(counter, 0, sizeof(counter));
+        }
+        last_tick += ticks * INPUT_DEBOUNCE_TICK_US;
+    }
+
+    raw = sample->vector;
+
+    /* Eager inputs react to the sample itself, not to the next tick */
+    Fire();
+
+    return state != previous;
+}
+
+/**
+  * @brief  Current debounced vector (1 = pressed)
+  */
+InputVector_t InputDebounce_GetState(void)
+{
+    return state;
+}
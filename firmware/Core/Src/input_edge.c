@@ -0,0 +1,185 @@
+/**
+  ******************************************************************************
+  * @file           : input_edge.c
+  * @brief          : EXTI edge-capture front end for the input scan engine
+  ******************************************************************************
+  * @attention
+  *
+  * The EXTI interrupts are the only producers of the event queue and all of
+  * them run at the same NVIC priority, so they never preempt each other and
+  * the queue stays single-producer/single-consumer without locking.
+  * The level is read back from IDR inside the interrupt, so when bounces
+  * merge into one pending EXTI request the last event still carries the
+  * settled level.
+  *
+  ******************************************************************************
+  */
+
+#include "input_edge.h"
+#include "timebase.h"
+#include <string.h>
+
+#if INPUT_EDGE_CAPTURE
+
+/* Pin routed to each EXTI line */
+typedef struct {
+    GPIO_TypeDef* port;     /* NULL if the line is unused */
+    uint8_t bit;            /* Input vector bit */
+    bool pressed;           /* Last level pushed for this line */
+} InputEdgeLine_t;
+
+static InputEdgeLine_t edge_lines[INPUT_EDGE_LINES];
+static InputVector_t edge_mask = 0;
+
+/* Event queue (head written by the EXTI interrupts only, tail by the consumer only) */
+static InputEdgeEvent_t edge_queue[INPUT_EDGE_QUEUE_SIZE];
+static volatile uint8_t edge_head = 0;
+static volatile uint8_t edge_tail = 0;
+static volatile bool edge_resync = false;
+
+static const IRQn_Type edge_irqs[] = {
+    EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn,
+    EXTI9_5_IRQn, EXTI15_10_IRQn
+};
+
+/**
+  * @brief  Route one scanned pin per EXTI line
+  * @note   Call after InputScan_Init() and Timebase_Init().
+  */
+void InputEdge_Init(void)
+{
+    GPIO_TypeDef* const ports[] = {GPIOA, GPIOB, GPIOC};
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    memset(edge_lines, 0, sizeof(edge_lines));
+    edge_mask = 0;
+    edge_head = 0;
+    edge_tail = 0;
+    edge_resync = false;
+
+    for (uint8_t line = 0; line < INPUT_EDGE_LINES; line++) {
+        uint16_t pin = (uint16_t)(1U << line);
+
+        /* First scanned pin in port order owns the line, the rest stay polled */
+        for (uint8_t p = 0; p < sizeof(ports) / sizeof(ports[0]); p++) {
+            uint8_t bit = InputScan_PinBit(ports[p], pin);
+            if (bit == INPUT_BIT_NONE) continue;
+
+            edge_lines[line].port = ports[p];
+            edge_lines[line].bit = bit;
+            edge_lines[line].pressed = !(ports[p]->IDR & pin);
+            edge_mask |= (InputVector_t)1 << bit;
+
+            GPIO_InitStruct.Pin = pin;
+            GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
+            GPIO_InitStruct.Pull = GPIO_PULLUP;
+            HAL_GPIO_Init(ports[p], &GPIO_InitStruct);
+            break;
+        }
+    }
+
+    /* Same priority for every line: producers never preempt each other */
+    for (uint8_t i = 0; i < sizeof(edge_irqs) / sizeof(edge_irqs[0]); i++) {
+        HAL_NVIC_SetPriority(edge_irqs[i], 0, 0);
+        HAL_NVIC_EnableIRQ(edge_irqs[i]);
+    }
+}
+
+/**
+  * @brief  Input vector bits that are delivered by edge capture
+  */
+InputVector_t InputEdge_GetMask(void)
+{
+    return edge_mask;
+}
+
+/**
+  * @brief  EXTI callback: timestamp the edge and queue it
+  * @param  pin: GPIO pin of the EXTI line that fired
+  */
+void InputEdge_IRQ(uint16_t pin)
+{
+    uint32_t now = Timebase_Micros();
+    uint8_t line = 31U - __CLZ(pin);
+    InputEdgeLine_t* edge = &edge_lines[line];
+
+    if (edge->port == NULL) {
+        return;
+    }
+
+    bool pressed = !(edge->port->IDR & pin);
+    if (pressed == edge->pressed) {
+        return;     /* Bounce already settled back to the reported level */
+    }
+
+    uint8_t head = edge_head;
+    if ((uint8_t)(head - edge_tail) >= INPUT_EDGE_QUEUE_SIZE) {
+        /* Consumer fell behind: drop the event and ask for a full resync */
+        edge_resync = true;
+        return;
+    }
+
+    InputEdgeEvent_t* event = &edge_queue[head & (INPUT_EDGE_QUEUE_SIZE - 1U)];
+    event->time = now;
+    event->bit = edge->bit;
+    event->pressed = pressed;
+    edge->pressed = pressed;
+    edge_head = head + 1U;
+}
+
+/**
+  * @brief  Pop the oldest edge event
+  * @param  event: Destination
+  * @retval true if an event was returned
+  */
+bool InputEdge_GetEvent(InputEdgeEvent_t* event)
+{
+    uint8_t tail = edge_tail;
+
+    if (tail == edge_head) {
+        return false;
+    }
+
+    *event = edge_queue[tail & (INPUT_EDGE_QUEUE_SIZE - 1U)];
+    edge_tail = tail + 1U;
+    return true;
+}
+
+/**
+  * @brief  Recover from a queue overflow
+  * @param  levels: Receives the current level of every edge-captured bit
+  * @retval true if events were lost; queued events are discarded and
+  *         levels holds the state to restart from
+  */
+bool InputEdge_TakeResync(InputVector_t* levels)
+{
+    if (!edge_resync) {
+        return false;
+    }
+
+    __disable_irq();
+    edge_resync = false;
+    edge_tail = edge_head;
+    *levels = 0;
+    for (uint8_t line = 0; line < INPUT_EDGE_LINES; line++) {
+        InputEdgeLine_t* edge = &edge_lines[line];
+        if (edge->port == NULL) continue;
+
+        edge->pressed = !(edge->port->IDR & (1U << line));
+        if (edge->pressed) {
+            *levels |= (InputVector_t)1 << edge->bit;
+        }
+    }
+    __enable_irq();
+    return true;
+}
+
+#else /* !INPUT_EDGE_CAPTURE */
+
+void InputEdge_Init(void) {}
+InputVector_t InputEdge_GetMask(void) { return 0; }
+bool InputEdge_GetEvent(InputEdgeEvent_t* event) { (void)event; return false; }
+bool InputEdge_TakeResync(InputVector_t* levels) { (void)levels; return false; }
+void InputEdge_IRQ(uint16_t pin) { (void)pin; }
+
+#endif /* INPUT_EDGE_CAPTURE */
@@ -0,0 +1,450 @@
+/**
+  ******************************************************************************
+  * @file           : input_scan.c
+  * @brief          : Port-snapshot input scan engine
+  ******************************************************************************
+  * @attention
+  *
+  * Instead of 34 HAL_GPIO_ReadPin() calls, a scan reads the three IDR
+  * registers back-to-back and compacts the used pins into the packed input
+  * vector with shift/mask runs precomputed at init. Vector bits are assigned
+  * port by port (GPIOA, GPIOB, GPIOC) in ascending pin order; consumers look
+  * up their bit once with InputScan_PinBit().
+  *
+  * Samples go through a single-producer/single-consumer ring: the producer is
+  * either the TIM2 update interrupt (INPUT_SCAN_TIMER) or InputScan_Poll()
+  * from the main loop (INPUT_SCAN_POLL); the consumer is always the main loop.
+  *
+  * INPUT_SCAN_DMA: each TIM2 period fires three DMA1 requests that copy one
+  * IDR each into a circular buffer: update -> Ch2 (GPIOA), CC3 -> Ch1 (GPIOB),
+  * CC4 -> Ch7 (GPIOC), with CCR3/CCR4 = 0 so all three land on the same tick.
+  * Ch2 has the lowest priority so when its half/full interrupt fires the
+  * GPIOB/GPIOC copies for the same samples are already in RAM. Only samples
+  * that differ from the previous one are queued, plus the last one of each
+  * half so the debounce timers keep advancing.
+  *
+  * INPUT_EDGE_CAPTURE: bits owned by an EXTI line are taken from the edge
+  * events instead of the scan, and each event is handed out as a sample of
+  * its own ahead of the queued scans, so a press reaches debounce as soon as
+  * its interrupt has run.
+  *
+  ******************************************************************************
+  */
+
+#include "input_scan.h"
+#include "input_edge.h"
+#include "timebase.h"
+#include "tim.h"
+#include <string.h>
+
+#define INPUT_PORT_COUNT    3
+#define INPUT_MAX_RUNS      8   /* Worst case: every other pin used */
+
+/* Run of adjacent pins moved into place with a single mask + shift */
+typedef struct {
+    uint16_t mask;          /* Pins covered by the run */
+    uint8_t shift;          /* Right shift that closes the gap below the run */
+} InputRun_t;
+
+/* Precomputed compaction for one GPIO port */
+typedef struct {
+    GPIO_TypeDef* port;
+    uint16_t used;          /* Pins that belong to the input vector */
+    uint8_t offset;         /* First vector bit of this port */
+    uint8_t run_count;
+    InputRun_t runs[INPUT_MAX_RUNS];
+} InputPortScan_t;
+
+/* All arcade inputs (active low, pull-ups enabled in MX_GPIO_Init) in
+ * connector silkscreen order (doc/PINOUT.md): 0-9, A-F, 10
+ * Player 1 (J6): 13 buttons, Right, Left, Down, Up
+ * Player 2 (J7): 13 buttons, Right, Left, Down, Up
+ */
+static const InputPin_t input_pins[INPUT_COUNT] = {
+    {P1_BTN1_GPIO_Port,  P1_BTN1_Pin},     /* 0  PA1  */
+    {P1_BTN2_GPIO_Port,  P1_BTN2_Pin},     /* 1  PA0  */
+    {P1_BTN3_GPIO_Port,  P1_BTN3_Pin},     /* 2  PC2  */
+    {P1_BTN4_GPIO_Port,  P1_BTN4_Pin},     /* 3  PC3  */
+    {P1_BTN5_GPIO_Port,  P1_BTN5_Pin},     /* 4  PC1  */
+    {P1_BTN6_GPIO_Port,  P1_BTN6_Pin},     /* 5  PC0  */
+    {P1_BTN7_GPIO_Port,  P1_BTN7_Pin},     /* 6  PC15 */
+    {P1_BTN8_GPIO_Port,  P1_BTN8_Pin},     /* 7  PC14 */
+    {P1_BTN9_GPIO_Port,  P1_BTN9_Pin},     /* 8  PC13 */
+    {P1_BTN10_GPIO_Port, P1_BTN10_Pin},    /* 9  PB9  */
+    {P1_BTN11_GPIO_Port, P1_BTN11_Pin},    /* A  PB8  */
+    {P1_BTN12_GPIO_Port, P1_BTN12_Pin},    /* B  PB7  */
+    {P1_BTN13_GPIO_Port, P1_BTN13_Pin},    /* C  PB6  */
+    {P1_RIGHT_GPIO_Port, P1_RIGHT_Pin},    /* D  PB5  */
+    {P1_LEFT_GPIO_Port,  P1_LEFT_Pin},     /* E  PB4  */
+    {P1_DOWN_GPIO_Port,  P1_DOWN_Pin},     /* F  PB3  */
+    {P1_UP_GPIO_Port,    P1_UP_Pin},       /* 10 PA15 */
+
+    {P2_BTN1_GPIO_Port,  P2_BTN1_Pin},     /* 0  PA7  */
+    {P2_BTN2_GPIO_Port,  P2_BTN2_Pin},     /* 1  PC4  */
+    {P2_BTN3_GPIO_Port,  P2_BTN3_Pin},     /* 2  PC5  */
+    {P2_BTN12_GPIO_Port, P2_BTN12_Pin},    /* 3  PB0  */
+    {P2_BTN13_GPIO_Port, P2_BTN13_Pin},    /* 4  PB1  */
+    {P2_BTN4_GPIO_Port,  P2_BTN4_Pin},     /* 5  PB2  */
+    {P2_BTN5_GPIO_Port,  P2_BTN5_Pin},     /* 6  PB10 */
+    {P2_BTN6_GPIO_Port,  P2_BTN6_Pin},     /* 7  PB11 */
+    {P2_BTN7_GPIO_Port,  P2_BTN7_Pin},     /* 8  PB12 */
+    {P2_BTN8_GPIO_Port,  P2_BTN8_Pin},     /* 9  PB13 */
+    {P2_BTN9_GPIO_Port,  P2_BTN9_Pin},     /* A  PB14 */
+    {P2_BTN10_GPIO_Port, P2_BTN10_Pin},    /* B  PB15 */
+    {P2_BTN11_GPIO_Port, P2_BTN11_Pin},    /* C  PC6  */
+    {P2_RIGHT_GPIO_Port, P2_RIGHT_Pin},    /* D  PC7  */
+    {P2_LEFT_GPIO_Port,  P2_LEFT_Pin},     /* E  PC8  */
+    {P2_DOWN_GPIO_Port,  P2_DOWN_Pin},     /* F  PC9  */
+    {P2_UP_GPIO_Port,    P2_UP_Pin},       /* 10 PA6  */
+};
+
+static InputPortScan_t port_scan[INPUT_PORT_COUNT];
+
+#if INPUT_SCAN_MODE == INPUT_SCAN_DMA
+/* DMA targets (lower 16 bits of each IDR read) */
+static uint16_t dma_idr_a[INPUT_DMA_BUFFER_SIZE];
+static uint16_t dma_idr_b[INPUT_DMA_BUFFER_SIZE];
+static uint16_t dma_idr_c[INPUT_DMA_BUFFER_SIZE];
+static InputVector_t dma_last_vector = 0;
+
+extern DMA_HandleTypeDef hdma_tim2_up;
+extern DMA_HandleTypeDef hdma_tim2_ch3;
+extern DMA_HandleTypeDef hdma_tim2_ch4;
+#endif
+
+/* Sample queue (head written by the producer only, tail by the consumer only) */
+static InputSample_t sample_queue[INPUT_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+static volatile uint32_t queue_overruns = 0;
+
+#if INPUT_EDGE_CAPTURE
+static InputVector_t edge_vector = 0;       /* Edge-captured bits */
+static InputVector_t polled_vector = 0;     /* Last scanned vector */
+#endif
+
+/**
+  * @brief  Count set bits in a 16-bit pin mask
+  */
+static uint8_t CountPins(uint16_t mask)
+{
+    uint8_t count = 0;
+    while (mask) {
+        mask &= mask - 1;
+        count++;
+    }
+    return count;
+}
+
+/**
+  * @brief  Build the per-port masks and shift runs from input_pins[]
+  */
+void InputScan_Init(void)
+{
+    GPIO_TypeDef* const ports[INPUT_PORT_COUNT] = {GPIOA, GPIOB, GPIOC};
+    uint8_t offset = 0;
+
+    memset(port_scan, 0, sizeof(port_scan));
+
+    for (uint8_t p = 0; p < INPUT_PORT_COUNT; p++) {
+        InputPortScan_t* scan = &port_scan[p];
+        scan->port = ports[p];
+        scan->offset = offset;
+
+        for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+            if (input_pins[i].port == scan->port) {
+                scan->used |= input_pins[i].pin;
+            }
+        }
+
+        /* Split the used mask into runs of adjacent pins */
+        uint8_t packed = 0;
+        uint8_t pin = 0;
+        while (pin < 16) {
+            if (!(scan->used & (1U << pin))) {
+                pin++;
+                continue;
+            }
+            uint8_t start = pin;
+            uint16_t mask = 0;
+            while (pin < 16 && (scan->used & (1U << pin))) {
+                mask |= (1U << pin);
+                pin++;
+            }
+            scan->runs[scan->run_count].mask = mask;
+            scan->runs[scan->run_count].shift = start - packed;
+            scan->run_count++;
+            packed += pin - start;
+        }
+
+        offset += packed;
+    }
+}
+
+/**
+  * @brief  Compact latched IDR values into the packed input vector
+  * @param  idr: IDR of GPIOA, GPIOB, GPIOC
+  */
+static InputVector_t CompactPorts(const uint32_t idr[INPUT_PORT_COUNT])
+{
+    InputVector_t vector = 0;
+
+    for (uint8_t p = 0; p < INPUT_PORT_COUNT; p++) {
+        const InputPortScan_t* scan = &port_scan[p];
+        uint32_t pressed = ~idr[p];     /* Active low: pressed when pin is LOW */
+        uint32_t packed = 0;
+
+        for (uint8_t r = 0; r < scan->run_count; r++) {
+            packed |= (pressed & scan->runs[r].mask) >> scan->runs[r].shift;
+        }
+
+        vector |= (InputVector_t)packed << scan->offset;
+    }
+
+    return vector;
+}
+
+/**
+  * @brief  Take a coherent snapshot of every input
+  * @retval Packed input vector (1 = pressed)
+  */
+InputVector_t InputScan_Read(void)
+{
+    uint32_t idr[INPUT_PORT_COUNT];
+
+    /* Latch all ports back-to-back so every button is sampled at one instant */
+    for (uint8_t p = 0; p < INPUT_PORT_COUNT; p++) {
+        idr[p] = port_scan[p].port->IDR;
+    }
+
+    return CompactPorts(idr);
+}
+
+/**
+  * @brief  Get the vector bit assigned to a GPIO pin
+  * @param  port: GPIO port
+  * @param  pin: GPIO pin (single GPIO_PIN_x)
+  * @retval Vector bit, or INPUT_BIT_NONE if the pin is not scanned
+  */
+uint8_t InputScan_PinBit(GPIO_TypeDef* port, uint16_t pin)
+{
+    for (uint8_t p = 0; p < INPUT_PORT_COUNT; p++) {
+        const InputPortScan_t* scan = &port_scan[p];
+        if (scan->port != port) continue;
+        if (!(scan->used & pin)) break;
+        return scan->offset + CountPins(scan->used & (pin - 1U));
+    }
+    return INPUT_BIT_NONE;
+}
+
+/**
+  * @brief  Get the vector bit of a connector input
+  * @param  player: 0 = Player 1 (J6), 1 = Player 2 (J7)
+  * @param  silk_pin: Silkscreen index on the connector (0-16)
+  * @retval Vector bit, or INPUT_BIT_NONE if out of range
+  */
+uint8_t InputScan_SilkBit(uint8_t player, uint8_t silk_pin)
+{
+    if (player > 1 || silk_pin >= INPUT_PINS_PER_PLAYER) {
+        return INPUT_BIT_NONE;
+    }
+
+    const InputPin_t* input = &input_pins[player * INPUT_PINS_PER_PLAYER + silk_pin];
+    return InputScan_PinBit(input->port, input->pin);
+}
+
+/**
+  * @brief  Store one sample in the queue (producer side)
+  * @note   When the consumer falls behind the newest slot is overwritten,
+  *         so the queue always ends with the current input state.
+  */
+static void PushSample(InputVector_t vector)
+{
+    uint8_t head = queue_head;
+
+    if ((uint8_t)(head - queue_tail) >= INPUT_QUEUE_SIZE) {
+        InputSample_t* last = &sample_queue[(uint8_t)(head - 1U) & (INPUT_QUEUE_SIZE - 1U)];
+        last->vector = vector;
+        last->time = Timebase_Micros();
+        queue_overruns++;
+        return;
+    }
+
+    sample_queue[head & (INPUT_QUEUE_SIZE - 1U)].vector = vector;
+    sample_queue[head & (INPUT_QUEUE_SIZE - 1U)].time = Timebase_Micros();
+    queue_head = head + 1U;
+}
+
+#if INPUT_SCAN_MODE == INPUT_SCAN_DMA
+/**
+  * @brief  Queue one half of the DMA buffers
+  * @param  first: First sample index of the half
+  */
+static void ProcessDmaHalf(uint8_t first)
+{
+    const uint8_t last = first + (INPUT_DMA_BUFFER_SIZE / 2) - 1;
+
+    for (uint8_t i = first; i <= last; i++) {
+        uint32_t idr[INPUT_PORT_COUNT] = {dma_idr_a[i], dma_idr_b[i], dma_idr_c[i]};
+        InputVector_t vector = CompactPorts(idr);
+
+        if (vector != dma_last_vector || i == last) {
+            dma_last_vector = vector;
+            PushSample(vector);
+        }
+    }
+}
+
+static void DmaHalfCallback(DMA_HandleTypeDef* hdma)
+{
+    (void)hdma;
+    ProcessDmaHalf(0);
+}
+
+static void DmaFullCallback(DMA_HandleTypeDef* hdma)
+{
+    (void)hdma;
+    ProcessDmaHalf(INPUT_DMA_BUFFER_SIZE / 2);
+}
+#endif
+
+/**
+  * @brief  Start sampling
+  * @note   In timer and DMA modes TIM2 is reprogrammed to overflow every
+  *         SCAN_INTERVAL_US; its update interrupt (timer) or its DMA
+  *         requests (DMA) take the samples.
+  */
+void InputScan_Start(void)
+{
+    queue_head = 0;
+    queue_tail = 0;
+    queue_overruns = 0;
+
+#if INPUT_EDGE_CAPTURE
+    InputEdge_Init();
+    polled_vector = InputScan_Read();
+    edge_vector = polled_vector & InputEdge_GetMask();
+#endif
+
+#if INPUT_SCAN_MODE != INPUT_SCAN_POLL
+    /* TIM2 runs from PCLK1 x2 when APB1 is divided (48 MHz here) */
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    __HAL_TIM_SET_PRESCALER(&htim2, (tim_clock / 1000000U) - 1U);
+    __HAL_TIM_SET_AUTORELOAD(&htim2, SCAN_INTERVAL_US - 1U);
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+
+    /* Load the new prescaler now and drop the update flag it raises */
+    htim2.Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(&htim2, TIM_FLAG_UPDATE);
+
+#if INPUT_SCAN_MODE == INPUT_SCAN_TIMER
+    HAL_TIM_Base_Start_IT(&htim2);
+#else
+    dma_last_vector = 0;
+    hdma_tim2_up.XferHalfCpltCallback = DmaHalfCallback;
+    hdma_tim2_up.XferCpltCallback = DmaFullCallback;
+
+    /* GPIOB/GPIOC channels run silently, GPIOA's interrupts drive processing */
+    HAL_DMA_Start(&hdma_tim2_ch3, (uint32_t)&GPIOB->IDR, (uint32_t)dma_idr_b, INPUT_DMA_BUFFER_SIZE);
+    HAL_DMA_Start(&hdma_tim2_ch4, (uint32_t)&GPIOC->IDR, (uint32_t)dma_idr_c, INPUT_DMA_BUFFER_SIZE);
+    HAL_DMA_Start_IT(&hdma_tim2_up, (uint32_t)&GPIOA->IDR, (uint32_t)dma_idr_a, INPUT_DMA_BUFFER_SIZE);
+
+    __HAL_TIM_ENABLE_DMA(&htim2, TIM_DMA_UPDATE | TIM_DMA_CC3 | TIM_DMA_CC4);
+    __HAL_TIM_ENABLE(&htim2);
+#endif
+#endif
+}
+
+/**
+  * @brief  Take one sample from the main loop
+  * @note   No-op in timer and DMA modes, where TIM2 already feeds the queue.
+  */
+void InputScan_Poll(void)
+{
+#if INPUT_SCAN_MODE == INPUT_SCAN_POLL
+    PushSample(InputScan_Read());
+#endif
+}
+
+/**
+  * @brief  TIM2 update handler: sample every input at the fixed scan rate
+  */
+void InputScan_TimerTick(void)
+{
+    PushSample(InputScan_Read());
+}
+
+/**
+  * @brief  Shift the TIM2 sampling phase
+  * @param  delay_us: A timer sample will be taken this many microseconds
+  *         from now (and every SCAN_INTERVAL_US around it)
+  * @note   Timer mode only. Lets the USB frame tracker put a sample just
+  *         before the report is loaded; safe from interrupt context.
+  */
+void InputScan_AlignTimer(uint32_t delay_us)
+{
+#if INPUT_SCAN_MODE == INPUT_SCAN_TIMER
+    /* The update fires when CNT wraps, i.e. (SCAN_INTERVAL_US - CNT) ticks from now */
+    __HAL_TIM_SET_COUNTER(&htim2, (SCAN_INTERVAL_US - (delay_us % SCAN_INTERVAL_US)) % SCAN_INTERVAL_US);
+#else
+    (void)delay_us;
+#endif
+}
+
+/**
+  * @brief  Pop the oldest queued sample (consumer side)
+  * @param  sample: Destination
+  * @retval true if a sample was returned
+  */
+bool InputScan_GetSample(InputSample_t* sample)
+{
+#if INPUT_EDGE_CAPTURE
+    const InputVector_t edge_mask = InputEdge_GetMask();
+    InputEdgeEvent_t event;
+    InputVector_t levels;
+
+    if (InputEdge_TakeResync(&levels)) {
+        edge_vector = levels;
+    }
+
+    if (InputEdge_GetEvent(&event)) {
+        if (event.pressed) {
+            edge_vector |= (InputVector_t)1 << event.bit;
+        } else {
+            edge_vector &= ~((InputVector_t)1 << event.bit);
+        }
+        sample->vector = edge_vector | (polled_vector & ~edge_mask);
+        sample->time = event.time;
+        return true;
+    }
+#endif
+
+    uint8_t tail = queue_tail;
+
+    if (tail == queue_head) {
+        return false;
+    }
+
+    /* On overrun the producer only rewrites the newest slot, never this one */
+    *sample = sample_queue[tail & (INPUT_QUEUE_SIZE - 1U)];
+
+    queue_tail = tail + 1U;
+
+#if INPUT_EDGE_CAPTURE
+    polled_vector = sample->vector;
+    sample->vector = edge_vector | (polled_vector & ~edge_mask);
+#endif
+    return true;
+}
+
+/**
+  * @brief  Number of samples merged because the consumer fell behind
+  */
+uint32_t InputScan_GetOverruns(void)
+{
+    return queue_overruns;
+}
@@ -0,0 +1,160 @@
+/**
+  ******************************************************************************
+  * @file           : input_socd.c
+  * @brief          : SOCD cleaning of the debounced input vector
+  ******************************************************************************
+  * @attention
+  *
+  * Each player has two axes (vertical, horizontal); an axis is a pair of
+  * opposite input bits. Only axes with a mode other than SOCD_OFF are kept
+  * in axes[], so the cost is one loop over the configured axes per input
+  * change and a single test when SOCD is off everywhere.
+  *
+  * Last input wins needs the press order: it is taken from the raw
+  * (uncleaned) vector of the previous call, so it is deterministic for a
+  * given sequence of debounced states.
+  *
+  ******************************************************************************
+  */
+
+#include "input_socd.h"
+#include <string.h>
+
+#define SOCD_MAX_AXES       4       /* 2 players x (vertical, horizontal) */
+
+/* Most recent press of an axis, for SOCD_LAST_WIN */
+#define SOCD_LAST_NONE      0
+#define SOCD_LAST_FIRST     1       /* Up / Left */
+#define SOCD_LAST_SECOND    2       /* Down / Right */
+
+/* One pair of opposite directions */
+typedef struct {
+    InputVector_t first;    /* Up or Left */
+    InputVector_t second;   /* Down or Right */
+    uint8_t mode;           /* InputSocdMode_t */
+    uint8_t player;
+    bool first_priority;    /* Vertical axis in SOCD_UP_PRIORITY */
+    uint8_t last;           /* SOCD_LAST_* */
+} InputSocdAxis_t;
+
+static InputSocdAxis_t axes[SOCD_MAX_AXES];
+static uint8_t axis_count = 0;
+static InputVector_t previous = 0;      /* Raw vector of the previous call */
+
+/**
+  * @brief  Disable SOCD cleaning for every player
+  */
+void InputSocd_Init(void)
+{
+    memset(axes, 0, sizeof(axes));
+    axis_count = 0;
+    previous = 0;
+}
+
+/**
+  * @brief  Add one axis if both directions are wired
+  */
+static void InputSocd_AddAxis(uint8_t player, InputSocdMode_t mode, uint8_t first, uint8_t second,
+                              bool vertical)
+{
+    if (first >= INPUT_COUNT || second >= INPUT_COUNT || axis_count >= SOCD_MAX_AXES) {
+        return;
+    }
+
+    InputSocdAxis_t* axis = &axes[axis_count++];
+    axis->first = (InputVector_t)1 << first;
+    axis->second = (InputVector_t)1 << second;
+    axis->mode = (uint8_t)mode;
+    axis->player = player;
+    axis->first_priority = vertical && (mode == SOCD_UP_PRIORITY);
+    axis->last = SOCD_LAST_NONE;
+}
+
+/**
+  * @brief  Set the SOCD mode and stick inputs of one player
+  * @param  player: 0 = Player 1, 1 = Player 2
+  * @param  mode: Resolution mode (invalid values mean SOCD_OFF)
+  * @param  stick: Input vector bits of the four directions
+  * @note   Called by the back end mapping callback; replaces the
+  *         player's previous setting.
+  */
+void InputSocd_SetPlayer(uint8_t player, InputSocdMode_t mode, const InputSocdStick_t* stick)
+{
+    /* Drop the player's current axes */
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < axis_count; i++) {
+        if (axes[i].player != player) {
+            axes[kept++] = axes[i];
+        }
+    }
+    axis_count = kept;
+
+    if (mode == SOCD_OFF || mode >= SOCD_MODE_COUNT) {
+        return;
+    }
+
+    InputSocd_AddAxis(player, mode, stick->up, stick->down, true);
+    InputSocd_AddAxis(player, mode, stick->left, stick->right, false);
+}
+
+/**
+  * @brief  Set the SOCD mode of one player wired to the standard stick pins
+  * @param  player: 0 = Player 1, 1 = Player 2
+  * @param  mode: Resolution mode
+  */
+void InputSocd_SetStandardStick(uint8_t player, InputSocdMode_t mode)
+{
+    InputSocdStick_t stick = {
+        .up = InputScan_SilkBit(player, SOCD_SILK_UP),
+        .down = InputScan_SilkBit(player, SOCD_SILK_DOWN),
+        .left = InputScan_SilkBit(player, SOCD_SILK_LEFT),
+        .right = InputScan_SilkBit(player, SOCD_SILK_RIGHT)
+    };
+
+    InputSocd_SetPlayer(player, mode, &stick);
+}
+
+/**
+  * @brief  Resolve opposite directions in a debounced input vector
+  * @param  state: Debounced input vector (1 = pressed)
+  * @retval Cleaned vector
+  * @note   Call once per debounced state change, in order.
+  */
+InputVector_t InputSocd_Apply(InputVector_t state)
+{
+    if (axis_count == 0) {
+        return state;
+    }
+
+    InputVector_t cleaned = state;
+    InputVector_t pressed_now = state & ~previous;
+
+    for (uint8_t i = 0; i < axis_count; i++) {
+        InputSocdAxis_t* axis = &axes[i];
+        bool new_first = (pressed_now & axis->first) != 0;
+        bool new_second = (pressed_now & axis->second) != 0;
+
+        if (new_first != new_second) {
+            axis->last = new_first ? SOCD_LAST_FIRST : SOCD_LAST_SECOND;
+        } else if (new_first) {
+            axis->last = SOCD_LAST_NONE;        /* Same sample: no order to go by */
+        }
+
+        if ((state & axis->first) == 0 || (state & axis->second) == 0) {
+            continue;
+        }
+
+        /* Both held */
+        InputVector_t keep = 0;
+        if (axis->first_priority) {
+            keep = axis->first;
+        } else if (axis->mode == SOCD_LAST_WIN) {
+            keep = (axis->last == SOCD_LAST_FIRST) ? axis->first :
+                   (axis->last == SOCD_LAST_SECOND) ? axis->second : 0;
+        }
+        cleaned &= ~((axis->first | axis->second) & ~keep);
+    }
+
+    previous = state;
+    return cleaned;
+}
@@ -23,22 +23,142 @@
   */
 
 #include "jvs_protocol.h"
+#include "input_core.h"
+#include "flash_config.h"
+#include "jvs_uart.h"
 #include "usart.h"
 #include <string.h>
 
-/* External UART handle */
-extern UART_HandleTypeDef huart1;
-
 /* JVS State */
 static JVS_State_t jvs_state = {0};
 static JVS_Packet_t rx_packet = {0};
-static JVS_Packet_t tx_packet = {0};
 
-/* Reception buffer */
-static uint8_t rx_buffer[JVS_MAX_PACKET_SIZE];
-static uint16_t rx_index = 0;
+/* Line rate of each communication method */
+static const uint32_t comm_baud[JVS_COMM_COUNT] = {
+    JVS_UART_BAUD_STANDARD, 1000000, 3000000
+};
+
+/* Communication method to switch to once the line is free */
+static uint8_t comm_pending = JVS_COMM_NONE;
+
+/* Reply frames are written escaped, behind room for the header, which
+   is filled in last (its length byte is only known at the end) */
+#define JVS_FRAME_HEADER_MAX    5       /* SYNC + escaped destination + escaped length */
+#define JVS_FRAME_SIZE(data)    (JVS_FRAME_HEADER_MAX + 2 * ((data) + 1))
+#define JVS_MAX_DATA            (JVS_MAX_PACKET_SIZE - 1)   /* The length byte counts the checksum */
+
+/* Streaming reply writer: escapes and sums each byte as it is appended */
+typedef struct {
+    uint8_t *buf;                       /* JVS_FRAME_SIZE(max_data) bytes */
+    uint16_t pos;                       /* Next escaped byte */
+    uint8_t count;                      /* Data bytes appended */
+    uint8_t max_data;
+    uint8_t sum;                        /* Running checksum of the data */
+    bool overflow;                      /* A byte did not fit */
+} JVS_FrameWriter_t;
+
+/* Escaped reply, read by the TX DMA until JvsUart_TxBusy() clears */
+static uint8_t tx_frame[JVS_FRAME_SIZE(JVS_MAX_DATA)];
+
+/* Last reply sent, for retransmit (in tx_frame or reply_cache.frame[]) */
+static const uint8_t *last_frame = NULL;
+static uint16_t last_frame_len = 0;     /* 0: nothing to retransmit */
+
+/* Pre-encoded reply to the host's polling request. Two buffers: a
+   refresh never overwrites the frame last sent, which a retransmit
+   request must get back unchanged */
+#define JVS_CACHE_REQUEST_MAX   8       /* Request data bytes */
+#define JVS_CACHE_REPLY_MAX     32      /* Reply data bytes */
+
+typedef struct {
+    uint8_t request[JVS_CACHE_REQUEST_MAX];
+    uint8_t request_len;
+    bool valid;                         /* request[] is known */
+    bool dirty;                         /* frame older than the switches/coins */
+    bool held;                          /* frame[current] is last_frame */
+    uint8_t current;                    /* frame[] holding the latest encoding */
+    const uint8_t *frame_start;         /* In frame[current] */
+    uint16_t frame_len;
+    uint8_t frame[2][JVS_FRAME_SIZE(JVS_CACHE_REPLY_MAX)];
+} JVS_ReplyCache_t;
+
+static JVS_ReplyCache_t reply_cache = {0};
+
+/* Reception state */
 static bool escape_next = false;
 
+/* JVS switch targets */
+#define JVS_TARGET_NONE         0
+#define JVS_TARGET_SWITCH       1   /* Bit in player_switches[index] */
+#define JVS_TARGET_COIN         2   /* Coin slot index, counted on press */
+
+/* Input to JVS switch mapping */
+typedef struct {
+    uint8_t target;         /* JVS_TARGET_* */
+    uint8_t index;          /* player_switches[] word or coin slot */
+    uint8_t bit;            /* Bit in the player_switches[] word */
+} JVS_SwitchMapping_t;
+
+#define SW(word, bit)   {JVS_TARGET_SWITCH, (word), (bit)}
+#define COIN(slot)      {JVS_TARGET_COIN, (slot), 0}
+
+/* Connector silkscreen pin (0-16) to JVS switch, per player (J6, J7) */
+static const JVS_SwitchMapping_t switch_map[JVS_NUM_PLAYERS][INPUT_PINS_PER_PLAYER] = {
+    {
+        SW(1, JVS_SW_BUTTON(1)), SW(1, JVS_SW_BUTTON(2)), SW(1, JVS_SW_BUTTON(3)),
+        SW(1, JVS_SW_BUTTON(4)), SW(1, JVS_SW_BUTTON(5)), SW(1, JVS_SW_BUTTON(6)),
+        SW(1, JVS_SW_BUTTON(7)), SW(1, JVS_SW_BUTTON(8)), SW(1, JVS_SW_BUTTON(9)),
+        SW(1, JVS_SW_BUTTON(10)),                       /* 0-9: Buttons 1-10 */
+        SW(1, JVS_SW_START),                            /* A: Start */
+        COIN(0),                                        /* B: Coin 1 */
+        SW(0, JVS_SYS_TEST),                            /* C: Test */
+        SW(1, JVS_SW_RIGHT), SW(1, JVS_SW_LEFT),
+        SW(1, JVS_SW_DOWN), SW(1, JVS_SW_UP),           /* D-10: Right, Left, Down, Up */
+    },
+    {
+        SW(2, JVS_SW_BUTTON(1)), SW(2, JVS_SW_BUTTON(2)), SW(2, JVS_SW_BUTTON(3)),
+        SW(2, JVS_SW_BUTTON(4)), SW(2, JVS_SW_BUTTON(5)), SW(2, JVS_SW_BUTTON(6)),
+        SW(2, JVS_SW_BUTTON(7)), SW(2, JVS_SW_BUTTON(8)), SW(2, JVS_SW_BUTTON(9)),
+        SW(2, JVS_SW_BUTTON(10)),                       /* 0-9: Buttons 1-10 */
+        SW(2, JVS_SW_START),                            /* A: Start */
+        COIN(1),                                        /* B: Coin 2 */
+        SW(2, JVS_SW_SERVICE),                          /* C: Service */
+        SW(2, JVS_SW_RIGHT), SW(2, JVS_SW_LEFT),
+        SW(2, JVS_SW_DOWN), SW(2, JVS_SW_UP),           /* D-10: Right, Left, Down, Up */
+    },
+};
+
+/* switch_map resolved to input vector bits (built by JVS_ApplyMap) */
+static JVS_SwitchMapping_t switch_by_bit[INPUT_COUNT];
+static InputVector_t mapped_mask = 0;
+
+/**
+  * @brief  Resolve switch_map to input vector bits
+  * @note   InputCore mapping callback.
+  */
+static void JVS_ApplyMap(void)
+{
+    memset(switch_by_bit, 0, sizeof(switch_by_bit));
+    mapped_mask = 0;
+    
+    for (uint8_t player = 0; player < JVS_NUM_PLAYERS; player++) {
+        for (uint8_t silk = 0; silk < INPUT_PINS_PER_PLAYER; silk++) {
+            uint8_t bit = InputScan_SilkBit(player, silk);
+            if (bit >= INPUT_COUNT || switch_map[player][silk].target == JVS_TARGET_NONE) continue;
+            
+            switch_by_bit[bit] = switch_map[player][silk];
+            mapped_mask |= (InputVector_t)1 << bit;
+        }
+    }
+    
+    /* switch_map puts the stick on the standard pins; SOCD and debounce from the joystick config */
+    JoystickConfig_t* config = FlashConfig_GetJoystick();
+    for (uint8_t player = 0; player < JVS_NUM_PLAYERS; player++) {
+        InputSocd_SetStandardStick(player, (InputSocdMode_t)config->socd_mode[player]);
+        InputCore_SetDebounce(player, config->debounce_mode[player]);
+    }
+}
+
 /**
   * @brief  Initialize JVS system
   */
@@ -47,16 +167,24 @@ void JVS_Init(void)
     /* Initialize state */
     memset(&jvs_state, 0, sizeof(JVS_State_t));
     jvs_state.device_id = 0xFF;  // Not assigned yet
+    jvs_state.comm_method = JVS_COMM_STANDARD;
     jvs_state.initialized = false;
+    comm_pending = JVS_COMM_NONE;
+    memset(&reply_cache, 0, sizeof(reply_cache));
     
     /* Set sense line to floating (input mode initially) */
     JVS_SetSenseLine(false);
     
     /* Clear buffers */
     memset(&rx_packet, 0, sizeof(JVS_Packet_t));
-    memset(&tx_packet, 0, sizeof(JVS_Packet_t));
-    rx_index = 0;
+    last_frame_len = 0;
     escape_next = false;
+    
+    /* Shared scan + debounce, switch_map resolved to vector bits */
+    InputCore_Init(JVS_ApplyMap);
+    
+    /* Non-blocking reception (circular DMA) */
+    JvsUart_Init();
 }
 
 /**
@@ -85,68 +213,97 @@ void JVS_SetSenseLine(bool state)
 }
 
 /**
-  * @brief  Calculate checksum
+  * @brief  Write one byte escaped
+  * @retval Bytes written (1 or 2)
   */
-static uint8_t JVS_CalcChecksum(uint8_t *data, uint16_t length)
+static inline uint16_t JVS_PutEscaped(uint8_t *dst, uint8_t byte)
 {
-    uint8_t sum = 0;
-    for (uint16_t i = 0; i < length; i++) {
-        sum += data[i];
+    if (byte == JVS_SYNC || byte == JVS_ESCAPE) {
+        dst[0] = JVS_ESCAPE;
+        dst[1] = byte - 1;
+        return 2;
     }
-    return sum;
+    dst[0] = byte;
+    return 1;
 }
 
 /**
-  * @brief  Escape special bytes for transmission
+  * @brief  Start a reply frame
+  * @param  buf: JVS_FRAME_SIZE(max_data) bytes
+  * @param  max_data: Data bytes the frame may carry (<= JVS_MAX_DATA)
   */
-static uint16_t JVS_EscapeData(uint8_t *src, uint16_t src_len, uint8_t *dst)
+static void JVS_FrameBegin(JVS_FrameWriter_t *w, uint8_t *buf, uint8_t max_data)
 {
-    uint16_t dst_idx = 0;
-    
-    dst[dst_idx++] = JVS_SYNC;
-    
-    for (uint16_t i = 0; i < src_len; i++) {
-        if (src[i] == JVS_SYNC || src[i] == JVS_ESCAPE) {
-            dst[dst_idx++] = JVS_ESCAPE;
-            dst[dst_idx++] = src[i] - 1;
-        } else {
-            dst[dst_idx++] = src[i];
-        }
+    w->buf = buf;
+    w->pos = JVS_FRAME_HEADER_MAX;
+    w->count = 0;
+    w->max_data = max_data;
+    w->sum = 0;
+    w->overflow = false;
+}
+
+/**
+  * @brief  Append one data byte (escaped, added to the checksum)
+  */
+static void JVS_FramePut(JVS_FrameWriter_t *w, uint8_t byte)
+{
+    if (w->count >= w->max_data) {
+        w->overflow = true;
+        return;
     }
-    
-    return dst_idx;
+    w->count++;
+    w->sum += byte;
+    w->pos += JVS_PutEscaped(&w->buf[w->pos], byte);
 }
 
 /**
-  * @brief  Send JVS packet
+  * @brief  Append a NUL-terminated string, terminator included
   */
-static void JVS_SendPacket(JVS_Packet_t *packet)
+static void JVS_FramePutString(JVS_FrameWriter_t *w, const char *str)
 {
-    uint8_t temp_buffer[JVS_MAX_PACKET_SIZE * 2];
-    uint8_t send_buffer[JVS_MAX_PACKET_SIZE * 2];
-    uint16_t temp_len = 0;
-    
-    /* Build raw packet */
-    temp_buffer[temp_len++] = packet->destination;
-    temp_buffer[temp_len++] = packet->length + 1;  // +1 for checksum
+    do {
+        JVS_FramePut(w, (uint8_t)*str);
+    } while (*str++ != '\0');
+}
+
+/**
+  * @brief  Drop the data appended so far
+  */
+static void JVS_FrameRewind(JVS_FrameWriter_t *w)
+{
+    JVS_FrameBegin(w, w->buf, w->max_data);
+}
+
+/**
+  * @brief  Close a reply frame: checksum, then the header in front of the data
+  * @param  destination: Destination address
+  * @param  start: Receives the first byte (SYNC) of the frame
+  * @retval Frame length in bytes
+  */
+static uint16_t JVS_FrameEnd(JVS_FrameWriter_t *w, uint8_t destination, const uint8_t **start)
+{
+    uint8_t length = w->count + 1;      /* +1 for checksum */
+    uint8_t checksum = destination + length + w->sum;
+    uint8_t header[4];
+    uint16_t header_len = 0;
     
-    for (uint8_t i = 0; i < packet->length; i++) {
-        temp_buffer[temp_len++] = packet->data[i];
-    }
+    w->pos += JVS_PutEscaped(&w->buf[w->pos], checksum);
     
-    /* Calculate and add checksum */
-    uint8_t checksum = JVS_CalcChecksum(temp_buffer, temp_len);
-    temp_buffer[temp_len++] = checksum;
+    header_len += JVS_PutEscaped(&header[header_len], destination);
+    header_len += JVS_PutEscaped(&header[header_len], length);
     
-    /* Escape special bytes */
-    uint16_t send_len = JVS_EscapeData(temp_buffer, temp_len, send_buffer);
+    uint16_t first = JVS_FRAME_HEADER_MAX - 1 - header_len;
+    w->buf[first] = JVS_SYNC;
+    memcpy(&w->buf[first + 1], header, header_len);
     
-    /* Transmit */
-    HAL_UART_Transmit(&huart1, send_buffer, send_len, JVS_TIMEOUT_MS);
+    *start = &w->buf[first];
+    return w->pos - first;
 }
 
 /**
   * @brief  Process received byte
+  * @note   Unescapes and sums in one pass; a length byte of 0 (no room
+  *         for the checksum) drops the frame.
   */
 static bool JVS_ProcessByte(uint8_t byte)
 {
@@ -157,7 +314,6 @@ static bool JVS_ProcessByte(uint8_t byte)
     /* Handle SYNC */
     if (byte == JVS_SYNC && !escape_next) {
         state = GET_DEST;
-        rx_index = 0;
         checksum = 0;
         return false;
     }
@@ -185,6 +341,10 @@ static bool JVS_ProcessByte(uint8_t byte)
             break;
             
         case GET_LEN:
+            if (byte == 0) {
+                state = WAIT_SYNC;  // Malformed: wait for the next frame
+                break;
+            }
             expected_len = byte - 1;  // -1 for checksum
             checksum += byte;
             rx_packet.length = 0;
@@ -211,26 +371,209 @@ static bool JVS_ProcessByte(uint8_t byte)
     return false;
 }
 
+/**
+  * @brief  Append a READ_SWITCHES reply
+  * @note   Players and bytes beyond the board's read as released.
+  */
+static void JVS_PutSwitches(JVS_FrameWriter_t *w, uint8_t num_players, uint8_t bytes_per_player)
+{
+    JVS_FramePut(w, JVS_REPORT_SUCCESS);
+    
+    /* System switches */
+    JVS_FramePut(w, (uint8_t)jvs_state.player_switches[0]);
+    
+    /* Player switches, first byte = bits 15-8 */
+    for (uint8_t p = 0; p < num_players; p++) {
+        uint16_t switches = (p < JVS_NUM_PLAYERS) ? jvs_state.player_switches[p + 1] : 0;
+        for (uint8_t b = 0; b < bytes_per_player; b++) {
+            JVS_FramePut(w, (b < 2) ? (uint8_t)(switches >> (8 * (1 - b))) : 0);
+        }
+    }
+}
+
+/**
+  * @brief  Append a READ_COINS reply
+  */
+static void JVS_PutCoins(JVS_FrameWriter_t *w, uint8_t num_coins)
+{
+    JVS_FramePut(w, JVS_REPORT_SUCCESS);
+    
+    for (uint8_t c = 0; c < num_coins; c++) {
+        uint16_t count = (c < JVS_NUM_COINS) ? jvs_state.coin_count[c] : 0;
+        JVS_FramePut(w, (count >> 8) & 0x3F);  // High 6 bits
+        JVS_FramePut(w, count & 0xFF);         // Low 8 bits
+    }
+}
+
+/**
+  * @brief  Remember a polling request so its reply can be pre-encoded
+  * @note   Only requests made of READ_SWITCHES and READ_COINS qualify:
+  *         their reply depends on nothing but the switches and coins.
+  */
+static void JVS_CacheLearn(JVS_Packet_t *rx)
+{
+    uint8_t idx = 0;
+    uint32_t reply_len = 1;     /* Status */
+    uint32_t cmd_reply;
+    
+    if (rx->destination != jvs_state.device_id || rx->length == 0 ||
+        rx->length > JVS_CACHE_REQUEST_MAX) {
+        return;
+    }
+    
+    while (idx < rx->length) {
+        if (rx->data[idx] == JVS_CMD_READ_SWITCHES && idx + 3 <= rx->length) {
+            cmd_reply = 2U + (uint32_t)rx->data[idx + 1] * rx->data[idx + 2];
+            idx += 3;
+        } else if (rx->data[idx] == JVS_CMD_READ_COINS && idx + 2 <= rx->length) {
+            cmd_reply = 1U + 2U * rx->data[idx + 1];
+            idx += 2;
+        } else {
+            return;
+        }
+        if (cmd_reply > JVS_CACHE_REPLY_MAX) {
+            return;
+        }
+        reply_len += cmd_reply;
+    }
+    
+    if (reply_len > JVS_CACHE_REPLY_MAX) {
+        return;
+    }
+    
+    memcpy(reply_cache.request, rx->data, rx->length);
+    reply_cache.request_len = rx->length;
+    reply_cache.valid = true;
+    reply_cache.dirty = true;
+}
+
+/**
+  * @brief  Check whether a request is the cached polling request
+  */
+static bool JVS_CacheMatches(JVS_Packet_t *rx)
+{
+    return reply_cache.valid && !reply_cache.dirty &&
+           rx->destination == jvs_state.device_id &&
+           rx->length == reply_cache.request_len &&
+           memcmp(rx->data, reply_cache.request, rx->length) == 0;
+}
+
+/**
+  * @brief  Re-encode the cached reply after a switch or coin change
+  * @note   Writes the buffer not holding last_frame, so the frame on the
+  *         wire or due for a retransmit stays as sent.
+  */
+static void JVS_CacheRefresh(void)
+{
+    JVS_FrameWriter_t w;
+    uint8_t idx = 0;
+    
+    if (!reply_cache.dirty || !reply_cache.valid) {
+        return;
+    }
+    
+    if (reply_cache.held) {
+        reply_cache.current ^= 1;
+        reply_cache.held = false;
+    }
+    
+    JVS_FrameBegin(&w, reply_cache.frame[reply_cache.current], JVS_CACHE_REPLY_MAX);
+    JVS_FramePut(&w, JVS_STATUS_SUCCESS);
+    
+    /* request[] was validated by JVS_CacheLearn */
+    while (idx < reply_cache.request_len) {
+        if (reply_cache.request[idx] == JVS_CMD_READ_SWITCHES) {
+            JVS_PutSwitches(&w, reply_cache.request[idx + 1], reply_cache.request[idx + 2]);
+            idx += 3;
+        } else {
+            JVS_PutCoins(&w, reply_cache.request[idx + 1]);
+            idx += 2;
+        }
+    }
+    
+    if (w.overflow) {
+        reply_cache.valid = false;      /* Left to JVS_HandlePacket */
+        return;
+    }
+    
+    reply_cache.frame_len = JVS_FrameEnd(&w, JVS_MASTER_ADDR, &reply_cache.frame_start);
+    reply_cache.dirty = false;
+}
+
+/**
+  * @brief  Switch to the pending communication method
+  * @note   Called with no reply in progress, so nothing is cut short.
+  */
+static void JVS_ApplyCommMethod(void)
+{
+    if (JvsUart_SetBaudRate(comm_baud[comm_pending])) {
+        jvs_state.comm_method = comm_pending;
+    }
+    comm_pending = JVS_COMM_NONE;
+}
+
+/**
+  * @brief  Bytes taken by a command and its arguments
+  * @retval 0 for unsupported commands
+  */
+static uint8_t JVS_CommandSize(uint8_t cmd)
+{
+    switch (cmd) {
+        case JVS_CMD_RESET:
+        case JVS_CMD_ASSIGN_ADDR:
+        case JVS_CMD_COMM_CHANGE:
+        case JVS_CMD_READ_COINS:
+            return 2;
+        case JVS_CMD_READ_SWITCHES:
+            return 3;
+        case JVS_CMD_REQUEST_ID:
+        case JVS_CMD_CMD_VER:
+        case JVS_CMD_JVS_VER:
+        case JVS_CMD_COMM_VER:
+        case JVS_CMD_CAPABILITIES:
+        case JVS_CMD_COMM_SUPPORTED:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 /**
   * @brief  Handle JVS command packet
+  * @param  w: Writer the reply is streamed into (already started)
+  * @retval true if w holds a reply to send
+  * @note   A command cut short by the end of the packet is answered with
+  *         JVS_REPORT_PARAM_ERROR and ends the packet; a reply too long
+  *         for the frame becomes JVS_STATUS_OVERFLOW.
   */
-static void JVS_HandlePacket(JVS_Packet_t *rx, JVS_Packet_t *tx)
+static bool JVS_HandlePacket(JVS_Packet_t *rx, JVS_FrameWriter_t *w)
 {
     /* Check if packet is for us */
     if (rx->destination != JVS_BROADCAST && rx->destination != jvs_state.device_id) {
-        return;  // Not for us
+        return false;  // Not for us
     }
     
     /* Setup response */
-    tx->destination = JVS_MASTER_ADDR;
-    tx->length = 0;
-    tx->data[tx->length++] = JVS_STATUS_SUCCESS;
+    JVS_FramePut(w, JVS_STATUS_SUCCESS);
     
     uint8_t cmd_idx = 0;
     
     while (cmd_idx < rx->length) {
         uint8_t cmd = rx->data[cmd_idx];
-        uint8_t cmd_size = 1;
+        uint8_t cmd_size = JVS_CommandSize(cmd);
+        
+        if (cmd_size == 0) {
+            /* Unsupported command */
+            JVS_FrameRewind(w);
+            JVS_FramePut(w, JVS_STATUS_UNSUPPORTED);
+            return true;
+        }
+        
+        if (cmd_idx + cmd_size > rx->length) {
+            /* Arguments missing */
+            JVS_FramePut(w, JVS_REPORT_PARAM_ERROR);
+            break;
+        }
         
         switch (cmd) {
             case JVS_CMD_RESET:
@@ -238,143 +581,138 @@ static void JVS_HandlePacket(JVS_Packet_t *rx, JVS_Packet_t *tx)
                 jvs_state.device_id = 0xFF;
                 jvs_state.initialized = false;
                 JVS_SetSenseLine(false);
-                cmd_size = 2;
+                reply_cache.valid = false;
+                if (jvs_state.comm_method != JVS_COMM_STANDARD) {
+                    comm_pending = JVS_COMM_STANDARD;   // Reset restores 115200
+                }
+                return false;   // Broadcast, no reply
+                
+            case JVS_CMD_COMM_SUPPORTED:
+                /* Supported communication methods */
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
+                JVS_FramePut(w, JVS_COMM_METHODS);
                 break;
                 
+            case JVS_CMD_COMM_CHANGE:
+                /* Switch methods once the line is free; the host has already switched */
+                if (rx->data[cmd_idx + 1] < JVS_COMM_COUNT &&
+                    (JVS_COMM_METHODS & (1U << rx->data[cmd_idx + 1]))) {
+                    comm_pending = rx->data[cmd_idx + 1];
+                }
+                return false;
+                
             case JVS_CMD_ASSIGN_ADDR:
                 /* Assign device address */
                 jvs_state.device_id = rx->data[cmd_idx + 1];
                 jvs_state.initialized = true;
                 JVS_SetSenseLine(true);
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                cmd_size = 2;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
                 break;
                 
             case JVS_CMD_REQUEST_ID:
                 /* Send board ID string */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                strcpy((char*)&tx->data[tx->length], JVS_BOARD_NAME);
-                tx->length += strlen(JVS_BOARD_NAME) + 1;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
+                JVS_FramePutString(w, JVS_BOARD_NAME);
                 break;
                 
             case JVS_CMD_CMD_VER:
                 /* Command version */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                tx->data[tx->length++] = JVS_CMD_VERSION;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
+                JVS_FramePut(w, JVS_CMD_VERSION);
                 break;
                 
             case JVS_CMD_JVS_VER:
                 /* JVS version */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                tx->data[tx->length++] = JVS_JVS_VERSION;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
+                JVS_FramePut(w, JVS_JVS_VERSION);
                 break;
                 
             case JVS_CMD_COMM_VER:
                 /* Communication version */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                tx->data[tx->length++] = JVS_COMM_VERSION;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
+                JVS_FramePut(w, JVS_COMM_VERSION);
                 break;
                 
             case JVS_CMD_CAPABILITIES:
                 /* Send capabilities */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
+                JVS_FramePut(w, JVS_REPORT_SUCCESS);
                 
                 /* Players capability */
-                tx->data[tx->length++] = JVS_CAP_PLAYERS;
-                tx->data[tx->length++] = JVS_NUM_PLAYERS;
-                tx->data[tx->length++] = JVS_BUTTONS_PER_PLAYER;
-                tx->data[tx->length++] = 0x00;
+                JVS_FramePut(w, JVS_CAP_PLAYERS);
+                JVS_FramePut(w, JVS_NUM_PLAYERS);
+                JVS_FramePut(w, JVS_BUTTONS_PER_PLAYER);
+                JVS_FramePut(w, 0x00);
                 
                 /* Coin slots capability */
-                tx->data[tx->length++] = JVS_CAP_COINS;
-                tx->data[tx->length++] = JVS_NUM_COINS;
-                tx->data[tx->length++] = 0x00;
-                tx->data[tx->length++] = 0x00;
+                JVS_FramePut(w, JVS_CAP_COINS);
+                JVS_FramePut(w, JVS_NUM_COINS);
+                JVS_FramePut(w, 0x00);
+                JVS_FramePut(w, 0x00);
                 
                 /* End of capabilities */
-                tx->data[tx->length++] = JVS_CAP_END;
+                JVS_FramePut(w, JVS_CAP_END);
                 break;
                 
             case JVS_CMD_READ_SWITCHES:
                 /* Read switch inputs */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                
-                /* System switches */
-                tx->data[tx->length++] = jvs_state.player_switches[0];
-                
-                /* Player switches */
-                uint8_t num_players = rx->data[cmd_idx + 1];
-                uint8_t bytes_per_player = rx->data[cmd_idx + 2];
-                
-                for (uint8_t p = 0; p < num_players; p++) {
-                    for (uint8_t b = 0; b < bytes_per_player; b++) {
-                        tx->data[tx->length++] = (jvs_state.player_switches[p + 1] >> (8 * (bytes_per_player - 1 - b))) & 0xFF;
-                    }
-                }
-                cmd_size = 3;
+                JVS_PutSwitches(w, rx->data[cmd_idx + 1], rx->data[cmd_idx + 2]);
                 break;
                 
             case JVS_CMD_READ_COINS:
                 /* Read coin counts */
-                tx->data[tx->length++] = JVS_REPORT_SUCCESS;
-                
-                uint8_t num_coins = rx->data[cmd_idx + 1];
-                for (uint8_t c = 0; c < num_coins; c++) {
-                    tx->data[tx->length++] = (jvs_state.coin_count[c] >> 8) & 0x3F;  // High 6 bits
-                    tx->data[tx->length++] = jvs_state.coin_count[c] & 0xFF;         // Low 8 bits
-                }
-                cmd_size = 2;
+                JVS_PutCoins(w, rx->data[cmd_idx + 1]);
                 break;
-                
-            case JVS_CMD_RETRANSMIT:
-                /* Retransmit last packet - already in tx */
-                return;
-                
-            default:
-                /* Unsupported command */
-                tx->data[0] = JVS_STATUS_UNSUPPORTED;
-                tx->length = 1;
-                return;
         }
         
         cmd_idx += cmd_size;
     }
+    
+    if (w->overflow) {
+        JVS_FrameRewind(w);
+        JVS_FramePut(w, JVS_STATUS_OVERFLOW);
+    }
+    
+    return true;
 }
 
 /**
   * @brief  Update inputs from GPIO to JVS state
+  * @note   Uses the debounced vector; the switch words are rebuilt only
+  *         when it changed.
   */
 void JVS_UpdateInputs(void)
 {
-    /* Map GPIO pins to JVS switches */
-    /* System switches (Test, Service, etc.) */
-    jvs_state.player_switches[0] = 0;
+    static InputVector_t previous = 0;
     
-    // Test button (PB2)
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_2) == GPIO_PIN_RESET) {
-        jvs_state.player_switches[0] |= (1 << 7);  // Test
+    if (!InputCore_Update()) {
+        return;
     }
     
-    /* Player 1 switches */
-    jvs_state.player_switches[1] = 0;
-    
-    // Start (PA7)
-    if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_7) == GPIO_PIN_RESET) {
-        jvs_state.player_switches[1] |= (1 << 7);
-    }
+    InputVector_t pressed = InputCore_GetState() & mapped_mask;
+    InputVector_t new_presses = pressed & ~previous;
+    previous = pressed;
     
-    // Buttons PB3-PB12
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_7) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 0);
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_8) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 1);
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_9) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 2);
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_10) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 3);
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_11) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 4);
-    if (HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_12) == GPIO_PIN_RESET) jvs_state.player_switches[1] |= (1 << 5);
+    uint16_t switches[JVS_NUM_PLAYERS + 1] = {0};
     
-    /* Player 2 switches - add your mappings here */
-    jvs_state.player_switches[2] = 0;
+    /* Only the pressed bits are visited (system switches in [0]) */
+    InputVector_t remaining = pressed;
+    while (remaining) {
+        uint8_t bit = InputScan_NextBit(&remaining);
+        const JVS_SwitchMapping_t* mapping = &switch_by_bit[bit];
+        
+        if (mapping->target == JVS_TARGET_COIN) {
+            if (InputScan_IsSet(new_presses, bit)) {
+                JVS_IncrementCoin(mapping->index);
+            }
+        } else {
+            switches[mapping->index] |= (uint16_t)(1U << mapping->bit);
+        }
+    }
     
-    // You can add more player mappings as needed
+    if (memcmp(jvs_state.player_switches, switches, sizeof(switches)) != 0) {
+        memcpy(jvs_state.player_switches, switches, sizeof(switches));
+        reply_cache.dirty = true;
+    }
 }
 
 /**
@@ -389,6 +727,7 @@ void JVS_SetSwitch(uint8_t player, uint8_t button, bool pressed)
     } else {
         jvs_state.player_switches[player] &= ~(1 << button);
     }
+    reply_cache.dirty = true;
 }
 
 /**
@@ -399,6 +738,52 @@ void JVS_IncrementCoin(uint8_t slot)
     if (slot < JVS_NUM_COINS) {
         if (jvs_state.coin_count[slot] < 16383) {  // Max coin count
             jvs_state.coin_count[slot]++;
+            reply_cache.dirty = true;
+        }
+    }
+}
+
+/**
+  * @brief  Answer the packet in rx_packet
+  * @note   The polling request is answered straight from the pre-encoded
+  *         frame; anything else goes through JVS_HandlePacket.
+  */
+static void JVS_Reply(void)
+{
+    JVS_FrameWriter_t w;
+    
+    /* Retransmit: the last frame again, without touching it */
+    if (rx_packet.length == 1 && rx_packet.data[0] == JVS_CMD_RETRANSMIT &&
+        rx_packet.destination == jvs_state.device_id) {
+        if (last_frame_len != 0) {
+            JvsUart_Transmit(last_frame, last_frame_len);
+        }
+        return;
+    }
+    
+    if (JVS_CacheMatches(&rx_packet)) {
+        last_frame = reply_cache.frame_start;
+        last_frame_len = reply_cache.frame_len;
+        reply_cache.held = true;
+        JvsUart_Transmit(last_frame, last_frame_len);
+        return;
+    }
+    
+    /* Not for us: leave the last reply in place */
+    if (rx_packet.destination != JVS_BROADCAST && rx_packet.destination != jvs_state.device_id) {
+        return;
+    }
+    
+    reply_cache.held = false;
+    JVS_FrameBegin(&w, tx_frame, JVS_MAX_DATA);
+    if (JVS_HandlePacket(&rx_packet, &w)) {
+        last_frame_len = JVS_FrameEnd(&w, JVS_MASTER_ADDR, &last_frame);
+        JvsUart_Transmit(last_frame, last_frame_len);
+        JVS_CacheLearn(&rx_packet);
+    } else {
+        last_frame_len = 0;
+        if (comm_pending != JVS_COMM_NONE) {
+            JVS_ApplyCommMethod();  /* Nothing to send: switch before the next byte */
         }
     }
 }
@@ -406,21 +791,47 @@ void JVS_IncrementCoin(uint8_t slot)
 /**
   * @brief  Process incoming JVS packets
   * Call this frequently in main loop
+  * @note   Never blocks: received bytes are taken from the DMA buffer,
+  *         a whole frame at a time once the line goes idle. Decoding
+  *         pauses while a reply is queued or on the wire.
   */
 void JVS_ProcessPackets(void)
 {
-    uint8_t byte;
-    
-    /* Check for received data */
-    if (HAL_UART_Receive(&huart1, &byte, 1, 1) == HAL_OK) {
-        /* Process byte */
-        if (JVS_ProcessByte(byte)) {
-            /* Complete packet received */
-            JVS_HandlePacket(&rx_packet, &tx_packet);
-            JVS_SendPacket(&tx_packet);
+    static bool rx_pending = false;
+    
+    /* A communication method change waits for the reply in progress */
+    if (comm_pending != JVS_COMM_NONE && !JvsUart_TxBusy()) {
+        JVS_ApplyCommMethod();
+    }
+    
+    /* Keep the polling reply current before the next request is decoded */
+    JVS_CacheRefresh();
+    
+    if (JvsUart_RxReady()) {
+        rx_pending = true;
+    }
+    
+    while (rx_pending && !JvsUart_TxBusy()) {
+        const uint8_t* data;
+        uint16_t len = JvsUart_Peek(&data);
+        uint16_t used = 0;
+        
+        if (len == 0) {
+            rx_pending = false;
+            break;
+        }
+        
+        while (used < len) {
+            if (JVS_ProcessByte(data[used++])) {
+                /* Complete packet received */
+                JVS_Reply();
+                break;
+            }
         }
+        JvsUart_Consume(used);
     }
     
-    /* Update inputs from GPIO */
+    /* Update inputs from GPIO, then re-encode the polling reply */
     JVS_UpdateInputs();
+    JVS_CacheRefresh();
 }
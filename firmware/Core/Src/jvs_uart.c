@@ -0,0 +1,322 @@
+/**
+  ******************************************************************************
+  * @file           : jvs_uart.c
+  * @brief          : JVS RS485 transport on USART1
+  ******************************************************************************
+  * @attention
+  *
+  * The DMA channel (DMA1 channel 5) runs in circular mode for as long as
+  * JVS mode is active; the write position is derived from its counter,
+  * so the interrupts only raise rx_event and never touch the buffer.
+  *
+  * Line errors are not enabled as interrupts: the HAL would abort the
+  * DMA reception on the first framing or noise error. A corrupted byte is
+  * left to the frame checksum instead.
+  *
+  * Transmit (DMA1 channel 4): the HAL enables the USART TC interrupt when
+  * the DMA has handed over the last byte, and HAL_UART_TxCpltCallback()
+  * runs once that byte is on the wire; that is where DE is released.
+  *
+  * A reply is started from interrupts only, so a slow main-loop pass
+  * cannot stretch the turnaround: JvsUart_Transmit() arms the timebase
+  * alarm for the end of the turnaround delay, the alarm asserts DE and
+  * re-arms itself for JVS_UART_DE_SETUP_US, and the second alarm hands
+  * the frame to the DMA. The alarm, USART1 and DMA interrupts share the
+  * top priority, so the state changes between them never nest.
+  *
+  ******************************************************************************
+  */
+
+#include "jvs_uart.h"
+#include "usart.h"
+#include "timebase.h"
+#include <string.h>
+
+/* Transmit states */
+#define JVS_UART_TX_IDLE        0
+#define JVS_UART_TX_PENDING     1       /* Waiting for the turnaround delay */
+#define JVS_UART_TX_SETUP       2       /* DE asserted, waiting for the driver */
+#define JVS_UART_TX_ACTIVE      3       /* DMA running */
+
+/* Receive buffer, written by DMA */
+static uint8_t rx_buffer[JVS_UART_RX_SIZE];
+static uint16_t rx_read = 0;                /* Next byte to hand out */
+static volatile bool rx_event = false;      /* IDLE or half/full transfer since last check */
+static volatile uint32_t rx_idle_time = 0;  /* Timebase_Micros() at the last IDLE */
+
+/* Transmit */
+static const uint8_t* tx_data = NULL;
+static uint16_t tx_len = 0;
+static volatile uint8_t tx_state = JVS_UART_TX_IDLE;
+static uint32_t tx_start_time = 0;          /* DE asserted */
+static uint16_t turnaround_delay_us = JVS_UART_TURNAROUND_US;
+
+/* Reply timing statistics */
+static uint32_t response_count = 0;
+static uint64_t response_sum = 0;
+static uint16_t response_min = 0xFFFF;
+static uint16_t response_max = 0;
+static uint16_t transmit_us = 0;
+
+/**
+  * @brief  Start the circular DMA reception and the IDLE-line interrupt
+  */
+void JvsUart_Init(void)
+{
+    rx_read = 0;
+    rx_event = false;
+    rx_idle_time = Timebase_Micros();
+    Timebase_CancelAlarm();
+    tx_state = JVS_UART_TX_IDLE;
+    JvsUart_ResetStats();
+
+    /* Receive until a reply is ready */
+    HAL_GPIO_WritePin(JVS_UART_DE_PORT, JVS_UART_DE_PIN, GPIO_PIN_RESET);
+
+    HAL_UART_Receive_DMA(&huart1, rx_buffer, JVS_UART_RX_SIZE);
+
+    /* Errors must not stop the DMA reception (see file header) */
+    CLEAR_BIT(huart1.Instance->CR3, USART_CR3_EIE);
+    CLEAR_BIT(huart1.Instance->CR1, USART_CR1_PEIE);
+
+    __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+    __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
+}
+
+/**
+  * @brief  Check for received data and clear the event
+  * @retval true if a frame ended (line idle) or the buffer filled up
+  *         by half since the last call
+  */
+bool JvsUart_RxReady(void)
+{
+    if (!rx_event) {
+        return false;
+    }
+    rx_event = false;
+    return true;
+}
+
+/**
+  * @brief  Look at the received bytes not consumed yet
+  * @param  data: Set to the first byte
+  * @retval Number of contiguous bytes at *data (0 if none); after a
+  *         wrap-around the rest comes with the next call
+  * @note   The bytes stay valid until the DMA comes round again, i.e.
+  *         for JVS_UART_RX_SIZE more received bytes.
+  */
+uint16_t JvsUart_Peek(const uint8_t** data)
+{
+    uint16_t write = (uint16_t)(JVS_UART_RX_SIZE - __HAL_DMA_GET_COUNTER(huart1.hdmarx));
+    if (write == JVS_UART_RX_SIZE) {
+        write = 0;      /* Counter reload in progress */
+    }
+
+    *data = &rx_buffer[rx_read];
+    return (uint16_t)(((write >= rx_read) ? write : JVS_UART_RX_SIZE) - rx_read);
+}
+
+/**
+  * @brief  Release bytes returned by JvsUart_Peek()
+  * @param  len: Bytes used, at most the value JvsUart_Peek() returned
+  */
+void JvsUart_Consume(uint16_t len)
+{
+    rx_read = (uint16_t)((rx_read + len) % JVS_UART_RX_SIZE);
+}
+
+/**
+  * @brief  Driver settled: hand the reply to the DMA
+  * @note   Timebase alarm (interrupt context).
+  */
+static void JvsUart_StartTransmit(void)
+{
+    uint32_t response = Timebase_Micros() - rx_idle_time;
+    uint16_t response16 = (response < 0xFFFFU) ? (uint16_t)response : 0xFFFFU;
+    response_count++;
+    response_sum += response16;
+    if (response16 < response_min) response_min = response16;
+    if (response16 > response_max) response_max = response16;
+
+    tx_state = JVS_UART_TX_ACTIVE;
+    if (HAL_UART_Transmit_DMA(&huart1, (uint8_t*)tx_data, tx_len) != HAL_OK) {
+        HAL_GPIO_WritePin(JVS_UART_DE_PORT, JVS_UART_DE_PIN, GPIO_PIN_RESET);
+        tx_state = JVS_UART_TX_IDLE;
+    }
+}
+
+/**
+  * @brief  Queue a reply frame
+  * @param  data: Escaped frame; must stay untouched until JvsUart_TxBusy()
+  *         returns false
+  * @param  len: Frame length in bytes
+  * @retval false if a reply is still in progress
+  * @note   The turnaround delay counts from the last request end; if it
+  *         has passed, DE goes up from the alarm interrupt right away.
+  */
+bool JvsUart_Transmit(const uint8_t* data, uint16_t len)
+{
+    if (tx_state != JVS_UART_TX_IDLE || len == 0) {
+        return false;
+    }
+
+    tx_data = data;
+    tx_len = len;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    tx_state = JVS_UART_TX_PENDING;
+    Timebase_SetAlarm(rx_idle_time + turnaround_delay_us);
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+  * @brief  Check whether a reply is queued or on the wire
+  */
+bool JvsUart_TxBusy(void)
+{
+    return tx_state != JVS_UART_TX_IDLE;
+}
+
+/**
+  * @brief  Turnaround over: assert DE; driver settled: start the DMA
+  * @note   Overrides the weak hook in timebase.c (TIM3 interrupt context).
+  */
+void Timebase_AlarmCallback(void)
+{
+    if (tx_state == JVS_UART_TX_PENDING) {
+        HAL_GPIO_WritePin(JVS_UART_DE_PORT, JVS_UART_DE_PIN, GPIO_PIN_SET);
+        tx_start_time = Timebase_Micros();
+        tx_state = JVS_UART_TX_SETUP;
+        Timebase_SetAlarm(tx_start_time + JVS_UART_DE_SETUP_US);
+    } else if (tx_state == JVS_UART_TX_SETUP) {
+        JvsUart_StartTransmit();
+    }
+}
+
+/**
+  * @brief  Set the minimum delay between the end of a request and the reply
+  * @param  turnaround_us: Microseconds after the line went idle
+  */
+void JvsUart_SetTurnaround(uint16_t turnaround_us)
+{
+    turnaround_delay_us = turnaround_us;
+}
+
+/**
+  * @brief  Switch the line to another baud rate
+  * @param  baud: New rate in bit/s
+  * @retval false if a reply is in progress or the USART divider cannot
+  *         get within JVS_UART_BAUD_TOLERANCE of the rate
+  * @note   Takes effect at once: call it with the line idle.
+  */
+bool JvsUart_SetBaudRate(uint32_t baud)
+{
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+
+    if (baud == 0 || tx_state != JVS_UART_TX_IDLE) {
+        return false;
+    }
+
+    /* BRR holds USARTDIV in 1/16 units: the rate obtained is pclk / BRR */
+    uint32_t brr = UART_BRR_SAMPLING16(pclk, baud);
+    if (brr < 16U || brr > 0xFFFFU) {
+        return false;
+    }
+    uint32_t actual = pclk / brr;
+    uint32_t error = (actual > baud) ? (actual - baud) : (baud - actual);
+    if ((uint64_t)error * 1000U > (uint64_t)baud * JVS_UART_BAUD_TOLERANCE) {
+        return false;
+    }
+
+    huart1.Instance->BRR = brr;
+    huart1.Init.BaudRate = baud;
+    return true;
+}
+
+/**
+  * @brief  Snapshot of the reply timing statistics
+  */
+void JvsUart_GetStats(JvsUartStats_t* stats)
+{
+    memset(stats, 0, sizeof(JvsUartStats_t));
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->replies = response_count;
+    stats->response_min_us = (response_count != 0) ? response_min : 0;
+    stats->response_avg_us = (response_count != 0) ? (uint16_t)(response_sum / response_count) : 0;
+    stats->response_max_us = response_max;
+    stats->transmit_us = transmit_us;
+    __set_PRIMASK(primask);
+
+    stats->turnaround_us = turnaround_delay_us;
+    stats->de_setup_us = JVS_UART_DE_SETUP_US;
+}
+
+/**
+  * @brief  Clear the reply timing statistics
+  */
+void JvsUart_ResetStats(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    response_count = 0;
+    response_sum = 0;
+    response_min = 0xFFFF;
+    response_max = 0;
+    transmit_us = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  USART1 interrupt hook: end of frame on IDLE
+  * @note   Called from USART1_IRQHandler before HAL_UART_IRQHandler.
+  */
+void JvsUart_IRQHandler(void)
+{
+    if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE) &&
+        __HAL_UART_GET_IT_SOURCE(&huart1, UART_IT_IDLE)) {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+        rx_idle_time = Timebase_Micros();
+        rx_event = true;
+    }
+}
+
+/**
+  * @brief  DMA half transfer: drain before the buffer wraps
+  */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART1) {
+        rx_event = true;
+    }
+}
+
+/**
+  * @brief  DMA transfer complete (circular: the buffer wrapped)
+  */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART1) {
+        rx_event = true;
+    }
+}
+
+/**
+  * @brief  Last stop bit sent: hand the bus back to the host
+  * @note   USART1 TC interrupt.
+  */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART1) {
+        return;
+    }
+
+    HAL_GPIO_WritePin(JVS_UART_DE_PORT, JVS_UART_DE_PIN, GPIO_PIN_RESET);
+
+    uint32_t elapsed = Timebase_Micros() - tx_start_time;
+    transmit_us = (elapsed < 0xFFFFU) ? (uint16_t)elapsed : 0xFFFFU;
+    tx_state = JVS_UART_TX_IDLE;
+}
@@ -20,6 +20,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "adc.h"
+#include "dma.h"
 #include "tim.h"
 #include "usart.h"
 #include "usb_device.h"
@@ -31,15 +32,15 @@
 #include "usbd_desc.h"
 #include "usbd_hid.h"
 #include "flash_config.h"
+#include "device_mode.h"
+#include "input_scan.h"
+#include "timebase.h"
+#include "usb_commands.h"
 
-/* Mode-specific includes */
-#ifdef USE_KEYBOARD_MODE
+/* Back ends (all built in, one selected at boot) */
 #include "arcade_keyboard.h"
-#elif defined(USE_JOYSTICK_MODE)
 #include "arcade_joystick.h"
-#elif defined(USE_JVS_MODE)
 #include "jvs_protocol.h"
-#endif
 
 /* GPIO Diagnostic Test */
 // #define GPIO_TEST_MODE  /* Uncomment to enable GPIO diagnostic test */
@@ -55,8 +56,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-/* Arcade Keyboard Controller - NKRO with minimal latency */
-#define SCAN_INTERVAL_US    500  /* Scan buttons every 500us (2000Hz) */
+/* Arcade Keyboard Controller - NKRO with minimal latency
+ * Scan rate: SCAN_INTERVAL_US in input_scan.h (TIM2 driven) */
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -115,39 +116,64 @@ int main(void)
   /* Ensure DFU pin (PD2) is LOW on startup to prevent accidental bootloader entry */
   HAL_GPIO_WritePin(GPIOD, GPIO_PIN_2, GPIO_PIN_RESET);
   
+  /* Load configuration from FLASH */
+  if (FlashConfig_Load() != HAL_OK)
+  {
+    /* Invalid parts were replaced by their defaults, save them to FLASH */
+    FlashConfig_Save();
+  }
+  
+  /* Precompute port masks for the input scan engine (used by every mode) */
+  InputScan_Init();
+  
+  /* Pick the device mode (flash or boot chord) before enumeration */
+  DeviceMode_Init();
+  
+  /* Descriptors and endpoint bInterval depend on the mode and config */
+  USBD_HID_SetDeviceMode(DeviceMode_Get());
+  USBD_HID_SetPollingInterval(FlashConfig_GetPollInterval());
+  
   /* USER CODE END 2 */
   
   MX_USB_DEVICE_Init();
+  MX_DMA_Init();
   // MX_ADC1_Init();  /* Disabled - ADC pins used as digital inputs for buttons */
   MX_TIM2_Init();
+  MX_TIM3_Init();
+  MX_TIM4_Init();
   MX_USART1_UART_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
   
-  /* Load configuration from FLASH */
-  if (FlashConfig_Load() != HAL_OK)
+  /* Start the microsecond timebase (TIM3 -> TIM4 cascade) */
+  Timebase_Init();
+  
+  switch (DeviceMode_Get())
   {
-    /* No valid config found, load defaults and save to FLASH */
-    FlashConfig_LoadDefaults();
-    FlashConfig_Save();
+    case DEVICE_MODE_KEYBOARD:
+      /* Initialize arcade keyboard system (NKRO USB HID mode) */
+      Arcade_Init();
+      break;
+    case DEVICE_MODE_JOYSTICK:
+      /* Initialize arcade joystick system (Dual Joystick USB HID mode) */
+      Joystick_Init();
+      break;
+    case DEVICE_MODE_JVS:
+    default:
+      /* Initialize JVS protocol system (RS485 mode) */
+      JVS_Init();
+      break;
   }
   
-#ifdef USE_KEYBOARD_MODE
-  /* Initialize arcade keyboard system (NKRO USB HID mode) */
-  Arcade_Init();
-#elif defined(USE_JOYSTICK_MODE)
-  /* Initialize arcade joystick system (Dual Joystick USB HID mode) */
-  Joystick_Init();
-#elif defined(USE_JVS_MODE)
-  /* Initialize JVS protocol system (RS485 mode) */
-  JVS_Init();
-#endif
-  
   /* Blink LED to indicate successful initialization */
   HAL_GPIO_WritePin(GPIOC, LED1_Pin, GPIO_PIN_SET);
   HAL_Delay(100);
   HAL_GPIO_WritePin(GPIOC, LED1_Pin, GPIO_PIN_RESET);
   
+  /* Start input sampling (TIM2 at SCAN_INTERVAL_US in timer mode,
+   * plus EXTI edge capture when INPUT_EDGE_CAPTURE is enabled) */
+  InputScan_Start();
+  
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -159,34 +185,45 @@ int main(void)
     GPIO_ContinuousTest();
     HAL_Delay(10);  /* Small delay to prevent UART overflow */
     
-#elif defined(USE_KEYBOARD_MODE)
-    /* USB HID Keyboard mode - High-speed button scanning with minimal latency */
-    
-    /* Scan buttons as fast as possible, but debounce handles timing */
-    Arcade_ProcessButtons();
-    
-    /* Send HID report only if state changed (reduces USB traffic) */
-    Arcade_SendKeyboardReport();
-    
-    /* No delay - run as fast as possible for minimal input latency!
-     * USB will throttle automatically at 1ms intervals (1000Hz polling) */
-     
-#elif defined(USE_JOYSTICK_MODE)
-    /* USB HID Joystick mode - Single joystick with 4 axes + 32 buttons */
-    
-    /* Scan all buttons and update joystick state */
-    Joystick_ProcessButtons();
-    
-    /* Send combined joystick report (P1+P2) */
-    Joystick_SendReport();
-    
-    /* No delay - USB polling handles timing (1000Hz) */
-    
-#elif defined(USE_JVS_MODE)
-    /* JVS Protocol mode - RS485 communication */
-    JVS_ProcessPackets();
+#else
+    switch (DeviceMode_Get())
+    {
+      case DEVICE_MODE_KEYBOARD:
+        /* USB HID Keyboard mode - High-speed button scanning with minimal latency */
+        
+        /* Drain the samples taken by TIM2 and debounce them */
+        Arcade_ProcessButtons();
+        
+        /* Send HID report only if state changed (reduces USB traffic) */
+        Arcade_SendKeyboardReport();
+        
+        /* No delay - run as fast as possible for minimal input latency!
+         * USB will throttle automatically at 1ms intervals (1000Hz polling) */
+        break;
+        
+      case DEVICE_MODE_JOYSTICK:
+        /* USB HID Joystick mode - Single joystick with 4 axes + 32 buttons */
+        
+        /* Drain the samples taken by TIM2 and update joystick state */
+        Joystick_ProcessButtons();
+        
+        /* Send combined joystick report (P1+P2) */
+        Joystick_SendReport();
+        
+        /* No delay - USB polling handles timing (1000Hz) */
+        break;
+        
+      case DEVICE_MODE_JVS:
+      default:
+        /* JVS Protocol mode - RS485 communication */
+        JVS_ProcessPackets();
+        
+        /* No delay needed, JVS_ProcessPackets never blocks */
+        break;
+    }
     
-    /* No delay needed, JVS_ProcessPackets has timeout handling */
+    /* Reset requested on the vendor interface, once its reply is out */
+    USB_Commands_Process();
 #endif
 
     /* USER CODE END WHILE */
@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file           : timebase.c
+  * @brief          : Microsecond monotonic timebase
+  ******************************************************************************
+  * @attention
+  *
+  * TIM3 (prescaled to 1 MHz) is the low half and master; TIM4 is slaved to
+  * TIM3's update TRGO through ITR2 in external clock mode and holds the high
+  * half. Both are configured in tim.c; the TIM3 prescaler is recomputed
+  * here from the APB1 timer clock, so a clock tree change keeps 1 us ticks.
+  *
+  ******************************************************************************
+  */
+
+#include "timebase.h"
+#include "tim.h"
+
+/**
+  * @brief  Start the cascade
+  * @note   Call after MX_TIM3_Init() and MX_TIM4_Init().
+  */
+void Timebase_Init(void)
+{
+    /* TIM3 runs from PCLK1 x2 when APB1 is divided (48 MHz here) */
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    __HAL_TIM_SET_PRESCALER(&htim3, (tim_clock / 1000000U) - 1U);
+
+    /* Load the new prescaler now (TIM4 is stopped, so the update is not counted) */
+    htim3.Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(&htim3, TIM_FLAG_UPDATE);
+
+    __HAL_TIM_SET_COUNTER(&htim3, 0);
+    __HAL_TIM_SET_COUNTER(&htim4, 0);
+
+    /* Slave first so it sees the very first overflow */
+    HAL_TIM_Base_Start(&htim4);
+    HAL_TIM_Base_Start(&htim3);
+}
+
+/**
+  * @brief  Current time in microseconds
+  * @note   Safe from any context: the high half is re-read until it is
+  *         stable around the low half read.
+  */
+uint32_t Timebase_Micros(void)
+{
+    uint16_t high;
+    uint16_t low;
+
+    do {
+        high = (uint16_t)TIM4->CNT;
+        low = (uint16_t)TIM3->CNT;
+    } while (high != (uint16_t)TIM4->CNT);
+
+    return ((uint32_t)high << 16) | low;
+}
+
+/**
+  * @brief  Busy-wait for a number of microseconds
+  */
+void Timebase_DelayUs(uint32_t us)
+{
+    uint32_t start = Timebase_Micros();
+
+    while (Timebase_Elapsed(start) < us) {
+    }
+}
+
+/**
+  * @brief  Arm the one-shot alarm
+  * @param  deadline: Timebase_Micros() value; at most 65535 us ahead, as
+  *         the compare only sees the TIM3 half
+  * @note   A deadline already reached fires at once. Re-arming replaces
+  *         a pending alarm.
+  */
+void Timebase_SetAlarm(uint32_t deadline)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    __HAL_TIM_SET_COMPARE(&htim3, TIM_CHANNEL_1, (uint16_t)deadline);
+    __HAL_TIM_CLEAR_FLAG(&htim3, TIM_FLAG_CC1);
+    __HAL_TIM_ENABLE_IT(&htim3, TIM_IT_CC1);
+
+    /* The compare only matches on equality: force the event if the
+       counter is already past it */
+    if (Timebase_Reached(deadline)) {
+        htim3.Instance->EGR = TIM_EGR_CC1G;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Disarm the alarm without calling back
+  */
+void Timebase_CancelAlarm(void)
+{
+    __HAL_TIM_DISABLE_IT(&htim3, TIM_IT_CC1);
+    __HAL_TIM_CLEAR_FLAG(&htim3, TIM_FLAG_CC1);
+}
+
+/**
+  * @brief  TIM3 interrupt hook: run the alarm once
+  * @note   Called from TIM3_IRQHandler before HAL_TIM_IRQHandler, which
+  *         then finds nothing left to do.
+  */
+void Timebase_IRQHandler(void)
+{
+    if (__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_CC1) &&
+        __HAL_TIM_GET_IT_SOURCE(&htim3, TIM_IT_CC1)) {
+        Timebase_CancelAlarm();
+        Timebase_AlarmCallback();
+    }
+}
+
+/**
+  * @brief  Alarm deadline reached (TIM3 interrupt context)
+  */
+__weak void Timebase_AlarmCallback(void)
+{
+}
@@ -8,6 +8,11 @@
 #include "usb_commands.h"
 #include "dfu_bootloader.h"
 #include "flash_config.h"
+#include "device_mode.h"
+#include "input_core.h"
+#include "usb_frame.h"
+#include "usb_latency.h"
+#include "jvs_uart.h"
 #include "usbd_ctlreq.h"
 #include "usbd_core.h"
 #include <string.h>
@@ -20,6 +25,63 @@
 /* Buffer for config data transfer (large enough for both keyboard and joystick configs) */
 static uint8_t config_buffer[1024];
 
+/* Active mode reply (must outlive the control IN transfer) */
+static uint8_t mode_data;
+
+/* Report timing snapshot (must outlive the control IN transfer) */
+static UsbFrameStats_t timing_stats;
+
+/* JVS reply timing snapshot (must outlive the control IN transfer) */
+static JvsUartStats_t jvs_stats;
+
+/* Vendor data interface reply */
+static uint8_t raw_reply[HID_RAW_REPORT_SIZE];
+
+/* Vendor data interface config write, assembled chunk by chunk in order */
+#define RAW_CONFIG_IDLE         0xFFFFU     /* No write in progress */
+static uint8_t raw_config_buffer[1024];
+static uint16_t raw_config_received = RAW_CONFIG_IDLE;  /* Bytes [0, n) received */
+
+/* Reset requested on the vendor data interface, run from USB_Commands_Process() */
+#define RAW_RESET_NONE          0
+#define RAW_RESET_SYSTEM        1
+#define RAW_RESET_BOOTLOADER    2
+#define RAW_RESET_TIMEOUT_MS    100     /* Reset anyway if the host does not collect the reply */
+static volatile uint8_t raw_reset = RAW_RESET_NONE;
+static volatile uint32_t raw_reset_tick = 0;
+
+/**
+  * @brief  RAM copy of the active mode's configuration
+  * @param  size: Receives the configuration size
+  */
+static uint8_t* USB_GetActiveConfig(uint16_t* size)
+{
+    if (DeviceMode_Get() == DEVICE_MODE_KEYBOARD)
+    {
+        *size = sizeof(KeyboardConfig_t);
+        return (uint8_t*)FlashConfig_GetKeyboard();
+    }
+    
+    *size = sizeof(JoystickConfig_t);
+    return (uint8_t*)FlashConfig_GetJoystick();
+}
+
+/**
+  * @brief  Apply a received configuration and save it
+  * @param  data: Whole configuration of the active mode
+  */
+static HAL_StatusTypeDef USB_ApplyConfig(const uint8_t* data)
+{
+    uint16_t size;
+    
+    memcpy(USB_GetActiveConfig(&size), data, size);
+    
+    /* New mapping takes effect right away, even if the flash write fails */
+    InputCore_ReloadConfig();
+    
+    return FlashConfig_Save();
+}
+
 /**
   * @brief  Process vendor-specific USB control transfer
   * @param  pdev: Device handle
@@ -29,6 +91,8 @@ static uint8_t config_buffer[1024];
 uint8_t USB_ProcessVendorCommand(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
 {
     uint8_t version_data[3];
+    HAL_StatusTypeDef status;
+    uint16_t size;
     
     switch (req->bRequest)
     {
@@ -75,43 +139,30 @@ uint8_t USB_ProcessVendorCommand(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
             break;
             
         case USB_REQ_CONFIG_READ:
-            /* Read current configuration and send to host */
-            #ifdef USE_KEYBOARD_MODE
-                KeyboardConfig_t *kb_config = FlashConfig_Get();
-                memcpy(config_buffer, kb_config, sizeof(KeyboardConfig_t));
-                USBD_CtlSendData(pdev, config_buffer, sizeof(KeyboardConfig_t));
-            #else
-                JoystickConfig_t *joy_config = FlashConfig_Get();
-                memcpy(config_buffer, joy_config, sizeof(JoystickConfig_t));
-                USBD_CtlSendData(pdev, config_buffer, sizeof(JoystickConfig_t));
-            #endif
+            /* Read the active mode's configuration and send to host */
+            memcpy(config_buffer, USB_GetActiveConfig(&size), size);
+            USBD_CtlSendData(pdev, config_buffer, size);
             return USBD_OK;
             break;
             
         case USB_REQ_CONFIG_WRITE:
-            /* Receive new configuration from host */
-            #ifdef USE_KEYBOARD_MODE
-                if (req->wLength == sizeof(KeyboardConfig_t))
-                {
-                    /* Prepare to receive data */
-                    USBD_CtlPrepareRx(pdev, config_buffer, req->wLength);
-                    return USBD_OK;
-                }
-            #else
-                if (req->wLength == sizeof(JoystickConfig_t))
-                {
-                    /* Prepare to receive data */
-                    USBD_CtlPrepareRx(pdev, config_buffer, req->wLength);
-                    return USBD_OK;
-                }
-            #endif
+            /* Receive new configuration for the active mode from host */
+            USB_GetActiveConfig(&size);
+            if (req->wLength == size)
+            {
+                /* Prepare to receive data */
+                USBD_CtlPrepareRx(pdev, config_buffer, req->wLength);
+                return USBD_OK;
+            }
             USBD_CtlError(pdev, req);
             return USBD_FAIL;
             break;
             
         case USB_REQ_CONFIG_RESET:
-            /* Reset configuration to defaults */
-            if (FlashConfig_Reset() == HAL_OK)
+            /* Reset configuration to defaults (RAM copy is reset even if the save fails) */
+            status = FlashConfig_Reset();
+            InputCore_ReloadConfig();
+            if (status == HAL_OK)
             {
                 USBD_CtlSendData(pdev, NULL, 0);
                 return USBD_OK;
@@ -123,6 +174,63 @@ uint8_t USB_ProcessVendorCommand(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
             }
             break;
             
+        case USB_REQ_GET_MODE:
+            /* Return the active DeviceMode_t as 1 byte */
+            mode_data = (uint8_t)DeviceMode_Get();
+            USBD_CtlSendData(pdev, &mode_data, 1);
+            return USBD_OK;
+            break;
+            
+        case USB_REQ_SET_MODE:
+            /* Store the new mode and re-enumerate with its descriptors */
+            if (DeviceMode_Set((DeviceMode_t)req->wValue) != HAL_OK)
+            {
+                USBD_CtlError(pdev, req);
+                return USBD_FAIL;
+            }
+            USBD_CtlSendData(pdev, NULL, 0);
+            HAL_Delay(100);
+            NVIC_SystemReset();
+            /* Never reached */
+            return USBD_OK;
+            break;
+            
+        case USB_REQ_GET_TIMING:
+            /* Return UsbFrameStats_t, optionally restarting the measurement */
+            UsbFrame_GetStats(&timing_stats);
+            if (req->wValue == 1)
+            {
+                UsbFrame_ResetStats();
+            }
+            USBD_CtlSendData(pdev, (uint8_t*)&timing_stats, sizeof(UsbFrameStats_t));
+            return USBD_OK;
+            break;
+            
+        case USB_REQ_SET_SOF_OFFSET:
+            /* Move the report load point (only used with USB_SOF_SYNC) */
+            UsbFrame_SetLoadOffset(req->wValue);
+            USBD_CtlSendData(pdev, NULL, 0);
+            return USBD_OK;
+            break;
+            
+        case USB_REQ_GET_JVS_TIMING:
+            /* Return JvsUartStats_t, optionally restarting the measurement */
+            JvsUart_GetStats(&jvs_stats);
+            if (req->wValue == 1)
+            {
+                JvsUart_ResetStats();
+            }
+            USBD_CtlSendData(pdev, (uint8_t*)&jvs_stats, sizeof(JvsUartStats_t));
+            return USBD_OK;
+            break;
+            
+        case USB_REQ_SET_JVS_TURNAROUND:
+            /* Hold JVS replies back until wValue us after the request */
+            JvsUart_SetTurnaround(req->wValue);
+            USBD_CtlSendData(pdev, NULL, 0);
+            return USBD_OK;
+            break;
+            
         default:
             /* Unknown vendor command */
             USBD_CtlError(pdev, req);
@@ -140,19 +248,219 @@ uint8_t USB_ProcessVendorCommand(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
 uint8_t USB_ProcessVendorData(USBD_HandleTypeDef *pdev)
 {
     /* Data received in config_buffer, now save to flash */
-    #ifdef USE_KEYBOARD_MODE
-        KeyboardConfig_t *kb_config = FlashConfig_Get();
-        memcpy(kb_config, config_buffer, sizeof(KeyboardConfig_t));
-    #else
-        JoystickConfig_t *joy_config = FlashConfig_Get();
-        memcpy(joy_config, config_buffer, sizeof(JoystickConfig_t));
-    #endif
-    
-    /* Save to flash */
-    if (FlashConfig_Save() == HAL_OK)
+    if (USB_ApplyConfig(config_buffer) == HAL_OK)
     {
         return USBD_OK;
     }
     
     return USBD_FAIL;
 }
+
+/**
+  * @brief  Queue a reply on the vendor data interface
+  * @param  cmd: Command code being answered
+  * @param  status: USB_RAW_STATUS_xxx
+  * @param  data: Reply data (NULL if none)
+  * @param  len: Data length (at most USB_RAW_PAYLOAD_SIZE)
+  * @retval USBD_OK if queued (usbd_hid_raw.c only runs a command with
+  *         room for its reply, so anything else means the host is gone)
+  */
+static uint8_t USB_SendRawReply(USBD_HandleTypeDef *pdev, uint8_t cmd, uint8_t status,
+                             const void* data, uint8_t len)
+{
+    raw_reply[0] = cmd;
+    raw_reply[1] = status;
+    raw_reply[2] = len;
+    raw_reply[3] = 0;
+    if (len != 0)
+    {
+        memcpy(&raw_reply[USB_RAW_HEADER_SIZE], data, len);
+    }
+    return USBD_HID_RAW_SendReport(pdev, raw_reply, (uint16_t)(USB_RAW_HEADER_SIZE + len));
+}
+
+/**
+  * @brief  Acknowledge a reset command and schedule the reset
+  * @param  action: RAW_RESET_SYSTEM or RAW_RESET_BOOTLOADER
+  * @note   The reset runs from USB_Commands_Process() once the reply has
+  *         been collected, never in the USB interrupt.
+  */
+static void USB_ScheduleRawReset(USBD_HandleTypeDef *pdev, uint8_t cmd, uint8_t action)
+{
+    if (USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, NULL, 0) != USBD_OK)
+    {
+        return;     /* Not acknowledged: not done either */
+    }
+    raw_reset_tick = HAL_GetTick();
+    raw_reset = action;
+}
+
+/**
+  * @brief  Process a command received on the vendor data interface
+  * @note   Overrides the weak hook in usbd_hid_raw.c (USB interrupt context).
+  */
+void USBD_HID_RAW_ReceiveCallback(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len)
+{
+    uint8_t version_data[3];
+    uint8_t mode;
+    uint16_t size;
+    uint8_t* config;
+    
+    if (len < USB_RAW_HEADER_SIZE || buf[3] > USB_RAW_PAYLOAD_SIZE ||
+        len < (uint16_t)(USB_RAW_HEADER_SIZE + buf[3]))
+    {
+        return;
+    }
+    
+    uint8_t cmd = buf[0];
+    uint16_t value = (uint16_t)(buf[1] | (buf[2] << 8));
+    uint8_t length = buf[3];
+    uint8_t* payload = &buf[USB_RAW_HEADER_SIZE];
+    
+    switch (cmd)
+    {
+        case USB_REQ_GET_VERSION:
+            version_data[0] = FIRMWARE_VERSION_MAJOR;
+            version_data[1] = FIRMWARE_VERSION_MINOR;
+            version_data[2] = FIRMWARE_VERSION_PATCH;
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, version_data, sizeof(version_data));
+            break;
+            
+        case USB_REQ_GET_MODE:
+            mode = (uint8_t)DeviceMode_Get();
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, &mode, 1);
+            break;
+            
+        case USB_REQ_GET_TIMING:
+            UsbFrame_GetStats(&timing_stats);
+            if (value == 1)
+            {
+                UsbFrame_ResetStats();
+            }
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, &timing_stats, sizeof(UsbFrameStats_t));
+            break;
+            
+        case USB_REQ_SET_SOF_OFFSET:
+            UsbFrame_SetLoadOffset(value);
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, NULL, 0);
+            break;
+            
+        case USB_REQ_GET_JVS_TIMING:
+            JvsUart_GetStats(&jvs_stats);
+            if (value == 1)
+            {
+                JvsUart_ResetStats();
+            }
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, &jvs_stats, sizeof(JvsUartStats_t));
+            break;
+            
+        case USB_REQ_SET_JVS_TURNAROUND:
+            JvsUart_SetTurnaround(value);
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, NULL, 0);
+            break;
+            
+        case USB_REQ_SET_LATENCY_PROBE:
+            /* Probe packets go to this interface, so there is no EP0 version */
+            UsbLatency_SetEnabled(value != 0);
+            USB_SendRawReply(pdev, cmd, USB_LATENCY_PROBE ? USB_RAW_STATUS_OK : USB_RAW_STATUS_ERROR, NULL, 0);
+            break;
+            
+        case USB_REQ_CONFIG_READ:
+            /* One chunk of the active configuration, wValue = offset */
+            config = USB_GetActiveConfig(&size);
+            if (value >= size)
+            {
+                USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_ERROR, NULL, 0);
+                break;
+            }
+            size = MIN((uint16_t)(size - value), (uint16_t)USB_RAW_PAYLOAD_SIZE);
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, config + value, (uint8_t)size);
+            break;
+            
+        case USB_REQ_CONFIG_WRITE:
+            /* One chunk, wValue = offset: chunks in order from offset 0, applied
+               with the one that completes the configuration */
+            USB_GetActiveConfig(&size);
+            if (value == 0)
+            {
+                raw_config_received = 0;    /* New write */
+            }
+            if (raw_config_received == RAW_CONFIG_IDLE || value != raw_config_received ||
+                length == 0 || (uint32_t)value + length > size)
+            {
+                raw_config_received = RAW_CONFIG_IDLE;  /* Lost or bad chunk: start over */
+                USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_ERROR, NULL, 0);
+                break;
+            }
+            memcpy(&raw_config_buffer[value], payload, length);
+            raw_config_received = (uint16_t)(value + length);
+            if (raw_config_received == size)
+            {
+                raw_config_received = RAW_CONFIG_IDLE;
+                if (USB_ApplyConfig(raw_config_buffer) != HAL_OK)
+                {
+                    USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_ERROR, NULL, 0);
+                    break;
+                }
+            }
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_OK, NULL, 0);
+            break;
+            
+        case USB_REQ_CONFIG_RESET:
+            /* RAM copy is reset even if the save fails */
+            mode = (FlashConfig_Reset() == HAL_OK) ? USB_RAW_STATUS_OK : USB_RAW_STATUS_ERROR;
+            InputCore_ReloadConfig();
+            USB_SendRawReply(pdev, cmd, mode, NULL, 0);
+            break;
+            
+        case USB_REQ_SET_MODE:
+            if (DeviceMode_Set((DeviceMode_t)value) != HAL_OK)
+            {
+                USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_ERROR, NULL, 0);
+                break;
+            }
+            USB_ScheduleRawReset(pdev, cmd, RAW_RESET_SYSTEM);
+            break;
+            
+        case USB_REQ_RESET_DEVICE:
+            USB_ScheduleRawReset(pdev, cmd, RAW_RESET_SYSTEM);
+            break;
+            
+        case USB_REQ_ENTER_BOOTLOADER:
+            if (value != BOOTLOADER_MAGIC)
+            {
+                USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_ERROR, NULL, 0);
+                break;
+            }
+            USB_ScheduleRawReset(pdev, cmd, RAW_RESET_BOOTLOADER);
+            break;
+            
+        default:
+            USB_SendRawReply(pdev, cmd, USB_RAW_STATUS_UNKNOWN, NULL, 0);
+            break;
+    }
+}
+
+/**
+  * @brief  Run a reset requested on the vendor data interface
+  * @note   Call from the main loop. Waits until the host has collected
+  *         the acknowledgement, or RAW_RESET_TIMEOUT_MS if it never does.
+  */
+void USB_Commands_Process(void)
+{
+    if (raw_reset == RAW_RESET_NONE)
+    {
+        return;
+    }
+    
+    if (!USBD_HID_RAW_TxIdle() && (HAL_GetTick() - raw_reset_tick) < RAW_RESET_TIMEOUT_MS)
+    {
+        return;
+    }
+    
+    if (raw_reset == RAW_RESET_BOOTLOADER)
+    {
+        DFU_EnterBootloader(100);
+    }
+    NVIC_SystemReset();
+}
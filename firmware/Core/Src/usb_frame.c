@@ -0,0 +1,191 @@
+/**
+  ******************************************************************************
+  * @file           : usb_frame.c
+  * @brief          : USB frame phase tracker and SOF-synchronised report timing
+  ******************************************************************************
+  * @attention
+  *
+  * SOF and DataIn are both handled in the USB interrupt; the report load is
+  * signalled from USBReport_Flush(), which runs with interrupts masked. The
+  * statistics are therefore only written from one context at a time and
+  * the main loop reads them with interrupts masked.
+  *
+  * The measured poll phase shows where the host actually collects the
+  * report inside the frame; USB_SOF_LOAD_OFFSET_US should stay ahead of it
+  * (in the previous frame) by more than the main loop pass time.
+  *
+  ******************************************************************************
+  */
+
+#include "usb_frame.h"
+#include "input_scan.h"
+#include "usbd_hid.h"
+#include "timebase.h"
+#include <string.h>
+
+/* Frame phase, written by the SOF interrupt */
+static volatile uint32_t sof_time = 0;      /* Timebase_Micros() at the last SOF */
+static volatile uint32_t sof_count = 0;     /* SOFs seen since init */
+static uint32_t loaded_frame = 0;           /* sof_count of the last load window used */
+static volatile uint16_t load_offset_us = USB_SOF_LOAD_OFFSET_US;
+
+/* Report age measurement, per IN endpoint */
+static uint32_t report_sample_time[HID_EPIN_COUNT];  /* Sample time of the report in the endpoint */
+static bool report_in_flight[HID_EPIN_COUNT];
+static uint32_t age_count = 0;
+static uint64_t age_sum = 0;
+static uint16_t age_min = 0xFFFF;
+static uint16_t age_max = 0;
+static uint16_t poll_phase = 0;
+
+/**
+  * @brief  Reset the frame tracker and the statistics
+  */
+void UsbFrame_Init(void)
+{
+    sof_time = 0;
+    sof_count = 0;
+    loaded_frame = 0;
+    memset(report_in_flight, 0, sizeof(report_in_flight));
+    UsbFrame_ResetStats();
+}
+
+/**
+  * @brief  Check whether the back end should load its report now
+  * @retval true once per frame at the load point with USB_SOF_SYNC, on
+  *         every call otherwise or while no SOF is being received
+  */
+bool UsbFrame_LoadDue(void)
+{
+#if USB_SOF_SYNC
+    uint32_t frame;
+    uint32_t start;
+
+    /* sof_time and sof_count must come from the same SOF */
+    do {
+        frame = sof_count;
+        start = sof_time;
+    } while (frame != sof_count);
+
+    uint32_t elapsed = Timebase_Elapsed(start);
+
+    /* Suspended, unconfigured or SOF lost: fall back to immediate loading */
+    if (frame == 0 || elapsed >= USB_SOF_TIMEOUT_US) {
+        return true;
+    }
+
+    if (frame == loaded_frame || elapsed < load_offset_us) {
+        return false;
+    }
+
+    loaded_frame = frame;
+    return true;
+#else
+    return true;
+#endif
+}
+
+/**
+  * @brief  Change the report load point
+  * @param  offset_us: Microseconds after SOF (clamped to the frame)
+  */
+void UsbFrame_SetLoadOffset(uint16_t offset_us)
+{
+    load_offset_us = (offset_us < USB_FRAME_US) ? offset_us : (USB_FRAME_US - 1U);
+}
+
+/**
+  * @brief  A report has been loaded into an IN endpoint
+  * @param  ep_index: HID_EPIN_INDEX() of the endpoint
+  * @param  sample_time: Time of the newest input sample in the report
+  * @note   Called from USBReport_Flush() with interrupts masked.
+  */
+void UsbFrame_ReportLoaded(uint8_t ep_index, uint32_t sample_time)
+{
+    if (ep_index >= HID_EPIN_COUNT) {
+        return;
+    }
+    report_sample_time[ep_index] = sample_time;
+    report_in_flight[ep_index] = true;
+}
+
+/**
+  * @brief  The host collected a report: record its age and poll phase
+  * @param  ep_index: HID_EPIN_INDEX() of the endpoint
+  * @note   USB interrupt context (DataIn).
+  */
+void UsbFrame_ReportCollected(uint8_t ep_index)
+{
+    if (ep_index >= HID_EPIN_COUNT || !report_in_flight[ep_index]) {
+        return;
+    }
+    report_in_flight[ep_index] = false;
+
+    uint32_t now = Timebase_Micros();
+    uint32_t age = now - report_sample_time[ep_index];
+    uint16_t age16 = (age < 0xFFFFU) ? (uint16_t)age : 0xFFFFU;
+
+    age_count++;
+    age_sum += age16;
+    if (age16 < age_min) age_min = age16;
+    if (age16 > age_max) age_max = age16;
+
+    uint32_t phase = now - sof_time;
+    poll_phase = (phase < 0xFFFFU) ? (uint16_t)phase : 0xFFFFU;
+}
+
+/**
+  * @brief  Snapshot of the report timing statistics
+  */
+void UsbFrame_GetStats(UsbFrameStats_t* stats)
+{
+    memset(stats, 0, sizeof(UsbFrameStats_t));
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->reports = age_count;
+    stats->age_min_us = (age_count != 0) ? age_min : 0;
+    stats->age_avg_us = (age_count != 0) ? (uint16_t)(age_sum / age_count) : 0;
+    stats->age_max_us = age_max;
+    stats->poll_phase_us = poll_phase;
+    __set_PRIMASK(primask);
+
+    stats->load_offset_us = load_offset_us;
+    stats->sof_sync = USB_SOF_SYNC;
+}
+
+/**
+  * @brief  Clear the report timing statistics
+  */
+void UsbFrame_ResetStats(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    age_count = 0;
+    age_sum = 0;
+    age_min = 0xFFFF;
+    age_max = 0;
+    poll_phase = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Start Of Frame: record the frame phase
+  * @note   Overrides the weak hook in usbd_hid.c (USB interrupt context).
+  */
+void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev)
+{
+    (void)pdev;
+
+    sof_time = Timebase_Micros();
+    sof_count++;
+    if (sof_count == 0) {
+        sof_count = 1;      /* 0 means "no SOF yet" */
+    }
+
+#if USB_SOF_SYNC
+    /* Put a timer sample just ahead of this frame's load point */
+    uint16_t offset = load_offset_us;
+    InputScan_AlignTimer((offset > USB_SOF_SAMPLE_LEAD_US) ? (offset - USB_SOF_SAMPLE_LEAD_US) : 0U);
+#endif
+}
@@ -0,0 +1,246 @@
+/**
+  ******************************************************************************
+  * @file           : usb_latency.c
+  * @brief          : Per-report input latency probe on the vendor interface
+  ******************************************************************************
+  * @attention
+  *
+  * A probe record follows its report through the scheduler: built when the
+  * back end submits the report, stamped when it is written to the endpoint
+  * (directly or staged in the second buffer), in flight once armed and
+  * sent to the host when the IN transfer completes. usb_report.c makes all
+  * calls with interrupts masked or from the USB interrupt.
+  *
+  * The inputs of a record are those that differ from the last report
+  * loaded for the same slot, restricted to the slot's inputs, so a
+  * coalesced report lists every edge it carries exactly once.
+  *
+  ******************************************************************************
+  */
+
+#include "usb_latency.h"
+#include "usb_report.h"
+#include "usb_commands.h"
+#include "input_core.h"
+#include "timebase.h"
+#include <stddef.h>
+#include <string.h>
+
+#if USB_LATENCY_PROBE
+
+/* External USB device handle */
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* Latency record of one report */
+typedef struct {
+    UsbLatencyProbe_t probe;
+    InputVector_t state;        /* Slot inputs pressed in this report */
+    bool valid;
+} UsbLatencyRecord_t;
+
+static volatile bool probe_enabled = false;
+static InputVector_t slot_inputs[USB_REPORT_SLOTS];     /* Inputs feeding each slot */
+static InputVector_t slot_loaded[USB_REPORT_SLOTS];     /* Slot inputs in the last loaded report */
+static UsbLatencyRecord_t pending[USB_REPORT_SLOTS];    /* Submitted, not loaded yet */
+static UsbLatencyRecord_t staged[HID_EPIN_COUNT];       /* In the second PMA buffer */
+static UsbLatencyRecord_t in_flight[HID_EPIN_COUNT];    /* Waiting for the IN token */
+
+/**
+  * @brief  Add the edges of a replaced report to the one replacing it
+  * @param  record: Report built on top of the replaced one
+  * @param  replaced: Report that will not be sent
+  * @note   An input listed in both has changed back and is dropped.
+  */
+static void UsbLatency_Merge(UsbLatencyRecord_t* record, const UsbLatencyRecord_t* replaced)
+{
+    UsbLatencyProbe_t* probe = &record->probe;
+    uint8_t count = probe->count & (uint8_t)~USB_LATENCY_TRUNCATED;
+    uint8_t truncated = (uint8_t)((probe->count | replaced->probe.count) & USB_LATENCY_TRUNCATED);
+    uint8_t kept = 0;
+    InputVector_t old_bits = 0;
+
+    for (uint8_t i = 0; i < (replaced->probe.count & (uint8_t)~USB_LATENCY_TRUNCATED); i++) {
+        old_bits |= (InputVector_t)1 << replaced->probe.edges[i].bit;
+    }
+
+    /* Keep the new edges that do not undo an old one */
+    for (uint8_t i = 0; i < count; i++) {
+        InputVector_t mask = (InputVector_t)1 << probe->edges[i].bit;
+        if (old_bits & mask) {
+            old_bits &= ~mask;
+            continue;
+        }
+        probe->edges[kept++] = probe->edges[i];
+    }
+
+    /* Then the old edges still standing, with their original times */
+    for (uint8_t i = 0; i < (replaced->probe.count & (uint8_t)~USB_LATENCY_TRUNCATED); i++) {
+        const UsbLatencyEdge_t* edge = &replaced->probe.edges[i];
+        if (!(old_bits & ((InputVector_t)1 << edge->bit))) {
+            continue;
+        }
+        if (kept == USB_LATENCY_MAX_EDGES) {
+            truncated = USB_LATENCY_TRUNCATED;
+            break;
+        }
+        probe->edges[kept++] = *edge;
+    }
+
+    probe->count = (uint8_t)(kept | truncated);
+}
+
+/**
+  * @brief  Clear all records; slot 0 carries every input until told otherwise
+  */
+void UsbLatency_Init(void)
+{
+    memset(slot_inputs, 0, sizeof(slot_inputs));
+    memset(slot_loaded, 0, sizeof(slot_loaded));
+    memset(pending, 0, sizeof(pending));
+    memset(staged, 0, sizeof(staged));
+    memset(in_flight, 0, sizeof(in_flight));
+    slot_inputs[0] = ~(InputVector_t)0;
+}
+
+/**
+  * @brief  Start or stop sending probe packets
+  * @note   USB interrupt context (vendor command).
+  */
+void UsbLatency_SetEnabled(bool enabled)
+{
+    probe_enabled = enabled;
+}
+
+/**
+  * @brief  Declare the inputs that feed one report slot
+  * @param  slot: Report slot
+  * @param  inputs: Input vector bits mapped into that slot's report
+  * @note   Called by the back end mapping callback.
+  */
+void UsbLatency_SetSlotInputs(uint8_t slot, InputVector_t inputs)
+{
+    if (slot < USB_REPORT_SLOTS) {
+        slot_inputs[slot] = inputs;
+    }
+}
+
+/**
+  * @brief  A report has been submitted: list the edges it carries
+  * @param  slot: Report slot
+  */
+void UsbLatency_Submit(uint8_t slot)
+{
+    if (slot >= USB_REPORT_SLOTS) {
+        return;
+    }
+
+    UsbLatencyRecord_t* record = &pending[slot];
+    InputVector_t state = InputCore_GetState() & slot_inputs[slot];
+    InputVector_t changed = state ^ slot_loaded[slot];
+    uint32_t now = Timebase_Micros();
+    uint8_t count = 0;
+
+    record->state = state;
+    record->probe.slot = slot;
+    while (changed) {
+        uint8_t bit = InputScan_NextBit(&changed);
+        if (count == USB_LATENCY_MAX_EDGES) {
+            count |= USB_LATENCY_TRUNCATED;
+            break;
+        }
+        UsbLatencyEdge_t* edge = &record->probe.edges[count++];
+        uint32_t edge_time = InputCore_GetEdgeTime(bit);
+        if (now - edge_time > 0xFFFFU) {
+            edge_time = now - 0xFFFFU;      /* Keep it within the 16-bit range */
+        }
+        edge->time = (uint16_t)edge_time;
+        edge->bit = bit;
+        edge->pressed = (uint8_t)((state >> bit) & 1U);
+    }
+    record->probe.count = count;
+    record->valid = true;
+}
+
+/**
+  * @brief  The slot's report has been written to an endpoint buffer
+  * @param  slot: Report slot
+  * @param  ep_index: HID_EPIN_INDEX() of the endpoint
+  * @param  staged_report: true if it waits behind the report in flight
+  */
+void UsbLatency_Loaded(uint8_t slot, uint8_t ep_index, bool staged_report)
+{
+    if (slot >= USB_REPORT_SLOTS || ep_index >= HID_EPIN_COUNT || !pending[slot].valid) {
+        return;
+    }
+
+    UsbLatencyRecord_t* record = staged_report ? &staged[ep_index] : &in_flight[ep_index];
+
+    /* Replacing a staged report of the same slot: that one never reaches
+       the host, so its edges move to the new report unless undone by it */
+    if (staged_report && record->valid && record->probe.slot == slot) {
+        UsbLatency_Merge(&pending[slot], record);
+    }
+
+    *record = pending[slot];
+    record->probe.load_time = (uint16_t)Timebase_Micros();
+    slot_loaded[slot] = record->state;
+    pending[slot].valid = false;
+}
+
+/**
+  * @brief  The staged report has been armed by the class driver
+  * @param  ep_index: HID_EPIN_INDEX() of the endpoint
+  */
+void UsbLatency_Armed(uint8_t ep_index)
+{
+    if (ep_index >= HID_EPIN_COUNT) {
+        return;
+    }
+    in_flight[ep_index] = staged[ep_index];
+    staged[ep_index].valid = false;
+}
+
+/**
+  * @brief  The host collected the report: queue its probe packet
+  * @param  ep_index: HID_EPIN_INDEX() of the endpoint
+  * @note   USB interrupt context (DataIn).
+  */
+void UsbLatency_Collected(uint8_t ep_index)
+{
+    if (ep_index >= HID_EPIN_COUNT || !in_flight[ep_index].valid) {
+        return;
+    }
+    in_flight[ep_index].valid = false;
+
+    if (!probe_enabled) {
+        return;
+    }
+
+    uint8_t packet[HID_RAW_REPORT_SIZE];
+    UsbLatencyProbe_t* probe = &in_flight[ep_index].probe;
+    uint8_t edges = probe->count & (uint8_t)~USB_LATENCY_TRUNCATED;
+    uint8_t len = (uint8_t)(offsetof(UsbLatencyProbe_t, edges) + edges * sizeof(UsbLatencyEdge_t));
+
+    probe->collect_time = Timebase_Micros();
+
+    packet[0] = USB_RAW_EVENT_LATENCY;
+    packet[1] = USB_RAW_STATUS_OK;
+    packet[2] = len;
+    packet[3] = 0;
+    memcpy(&packet[USB_RAW_HEADER_SIZE], probe, len);
+
+    /* Dropped if the host is not reading the vendor interface */
+    USBD_HID_RAW_SendReport(&hUsbDeviceFS, packet, (uint16_t)(USB_RAW_HEADER_SIZE + len));
+}
+
+#else /* !USB_LATENCY_PROBE */
+
+void UsbLatency_Init(void) {}
+void UsbLatency_SetEnabled(bool enabled) { (void)enabled; }
+void UsbLatency_SetSlotInputs(uint8_t slot, InputVector_t inputs) { (void)slot; (void)inputs; }
+void UsbLatency_Submit(uint8_t slot) { (void)slot; }
+void UsbLatency_Loaded(uint8_t slot, uint8_t ep_index, bool staged_report) { (void)slot; (void)ep_index; (void)staged_report; }
+void UsbLatency_Armed(uint8_t ep_index) { (void)ep_index; }
+void UsbLatency_Collected(uint8_t ep_index) { (void)ep_index; }
+
+#endif /* USB_LATENCY_PROBE */
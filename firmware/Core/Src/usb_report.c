@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file           : usb_report.c
+  * @brief          : Coalescing HID report scheduler
+  ******************************************************************************
+  * @attention
+  *
+  * Producers are the main loop (USBReport_Submit) and the consumer is
+  * USBReport_Flush(), which runs from both the main loop and the USB
+  * interrupt (DataIn). Slot updates and the send decision are made with
+  * interrupts masked; the STM32F1 USB driver copies the report into PMA
+  * inside USBD_LL_Transmit(), so a slot can be overwritten as soon as the
+  * transfer has been started.
+  *
+  * While an endpoint is busy, the next pending report is staged into its
+  * second PMA buffer (USBD_HID_StageReportEP) and armed by the class driver
+  * in the DataIn interrupt, so it is ready for the very next IN token. On a
+  * shared endpoint only one slot can be staged at a time; the others wait
+  * for the next DataIn as before.
+  *
+  * Slots submitted as input vectors are built by the back end's builder
+  * directly into the idle PMA buffer (USBD_HID_GetReportBufferEP) and
+  * then sent or staged the same way. The builder may therefore run in the
+  * DataIn interrupt; InputCore rebuilds mappings with interrupts masked,
+  * so it never sees a half-built table.
+  *
+  ******************************************************************************
+  */
+
+#include "usb_report.h"
+#include "usb_frame.h"
+#include "usb_latency.h"
+#include "input_core.h"
+#include <string.h>
+
+/* External USB device handle */
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/* Latest report of one report ID */
+typedef struct {
+    uint8_t data[USB_REPORT_MAX_SIZE];
+    uint16_t len;
+    InputVector_t inputs;   /* Builder input (USBReport_SubmitInputs) */
+    uint32_t time;          /* Newest input sample in the report */
+    bool dirty;             /* Not sent to the host yet */
+    bool direct;            /* Built into packet memory from inputs */
+} USBReportSlot_t;
+
+/* Result of loading a slot into its endpoint */
+#define USB_REPORT_NOT_LOADED   0
+#define USB_REPORT_SENT         1   /* Armed for the next IN token */
+#define USB_REPORT_STAGED       2   /* Armed from DataIn, behind the report in flight */
+
+/* Report staged behind the one in flight, per IN endpoint */
+typedef struct {
+    uint8_t slot;           /* USB_REPORT_SLOT_NONE if nothing staged */
+    uint32_t time;
+} USBReportStaged_t;
+
+#define USB_REPORT_SLOT_NONE    0xFF
+
+static USBReportSlot_t slots[USB_REPORT_SLOTS];
+static USBReportStaged_t staged[HID_EPIN_COUNT];
+static uint8_t next_slot = 0;   /* Round-robin start, so no slot can starve the others */
+static USBReport_Builder_t report_builder = NULL;
+static uint16_t builder_len = 0;
+
+/**
+  * @brief  Clear all slots
+  */
+void USBReport_Init(void)
+{
+    memset(slots, 0, sizeof(slots));
+    for (uint8_t i = 0; i < HID_EPIN_COUNT; i++) {
+        staged[i].slot = USB_REPORT_SLOT_NONE;
+    }
+    next_slot = 0;
+    report_builder = NULL;
+    builder_len = 0;
+    UsbFrame_Init();
+    UsbLatency_Init();
+}
+
+/**
+  * @brief  Register the builder used by USBReport_SubmitInputs()
+  * @param  builder: Writes one report into packet memory
+  * @param  len: Length of every built report (at most USB_REPORT_MAX_SIZE)
+  */
+void USBReport_SetBuilder(USBReport_Builder_t builder, uint16_t len)
+{
+    report_builder = builder;
+    builder_len = (len <= USB_REPORT_MAX_SIZE) ? len : 0U;
+}
+
+/**
+  * @brief  Queue the latest state of one report
+  * @param  slot: Report slot (0 .. USB_REPORT_SLOTS-1)
+  * @param  report: Report bytes, including the Report ID if any
+  * @param  len: Report length (at most USB_REPORT_MAX_SIZE)
+  * @note   Replaces any unsent report in the same slot.
+  */
+void USBReport_Submit(uint8_t slot, const void* report, uint16_t len)
+{
+    if (slot >= USB_REPORT_SLOTS || len > USB_REPORT_MAX_SIZE) {
+        return;
+    }
+    
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(slots[slot].data, report, len);
+    slots[slot].len = len;
+    slots[slot].time = InputCore_GetSampleTime();
+    slots[slot].dirty = true;
+    slots[slot].direct = false;
+    UsbLatency_Submit(slot);
+    __set_PRIMASK(primask);
+    
+    USBReport_Flush();
+}
+
+/**
+  * @brief  Queue the latest inputs of one report built by the builder
+  * @param  slot: Report slot (0 .. USB_REPORT_SLOTS-1)
+  * @param  inputs: Input vector bits the builder turns into the report
+  * @note   The report is only built when it is loaded into the endpoint,
+  *         so intermediate states never cost a build.
+  */
+void USBReport_SubmitInputs(uint8_t slot, InputVector_t inputs)
+{
+    if (slot >= USB_REPORT_SLOTS || report_builder == NULL || builder_len == 0U) {
+        return;
+    }
+    
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    slots[slot].inputs = inputs;
+    slots[slot].len = builder_len;
+    slots[slot].time = InputCore_GetSampleTime();
+    slots[slot].dirty = true;
+    slots[slot].direct = true;
+    UsbLatency_Submit(slot);
+    __set_PRIMASK(primask);
+    
+    USBReport_Flush();
+}
+
+/**
+  * @brief  Write a slot's report into its endpoint
+  * @param  can_stage: The endpoint's second buffer may be used for this slot
+  * @retval USB_REPORT_*
+  * @note   Interrupts masked.
+  */
+static uint8_t USBReport_Load(uint8_t slot, uint8_t ep, bool can_stage)
+{
+    USBReportSlot_t* pending = &slots[slot];
+    
+    if (pending->direct) {
+        /* Another slot staged means the endpoint is busy and its idle buffer taken */
+        volatile uint16_t* pma = can_stage ? USBD_HID_GetReportBufferEP(&hUsbDeviceFS, ep, pending->len) : NULL;
+        if (pma == NULL) {
+            return USB_REPORT_NOT_LOADED;
+        }
+        report_builder(slot, pending->inputs, pma);
+        return (USBD_HID_CommitReportEP(&hUsbDeviceFS, ep, pending->len) == USBD_OK) ?
+               USB_REPORT_SENT : USB_REPORT_STAGED;
+    }
+    
+    uint8_t status = USBD_HID_SendReportEP(&hUsbDeviceFS, ep, pending->data, pending->len);
+    if (status == USBD_OK) {
+        return USB_REPORT_SENT;
+    }
+    if (status == USBD_BUSY && can_stage &&
+        USBD_HID_StageReportEP(&hUsbDeviceFS, ep, pending->data, pending->len) == USBD_OK) {
+        return USB_REPORT_STAGED;
+    }
+    return USB_REPORT_NOT_LOADED;
+}
+
+/**
+  * @brief  Start sending the next pending report if the endpoint is free
+  * @note   Safe from main loop and interrupt context.
+  */
+void USBReport_Flush(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    
+    for (uint8_t i = 0; i < USB_REPORT_SLOTS; i++) {
+        uint8_t slot = (uint8_t)((next_slot + i) % USB_REPORT_SLOTS);
+        if (!slots[slot].dirty) continue;
+        
+        uint8_t ep = USB_REPORT_EP(slot);
+        uint8_t index = HID_EPIN_INDEX(ep);
+        bool can_stage = (staged[index].slot == USB_REPORT_SLOT_NONE || staged[index].slot == slot);
+        uint8_t status = USBReport_Load(slot, ep, can_stage);
+        
+        if (status == USB_REPORT_SENT) {
+            slots[slot].dirty = false;
+            staged[index].slot = USB_REPORT_SLOT_NONE;
+            UsbFrame_ReportLoaded(index, slots[slot].time);
+            UsbLatency_Loaded(slot, index, false);
+            next_slot = (uint8_t)((slot + 1U) % USB_REPORT_SLOTS);
+        } else if (status == USB_REPORT_STAGED) {
+            /* Goes out right after the report in flight */
+            slots[slot].dirty = false;
+            staged[index].slot = slot;
+            staged[index].time = slots[slot].time;
+            UsbLatency_Loaded(slot, index, true);
+            next_slot = (uint8_t)((slot + 1U) % USB_REPORT_SLOTS);
+        }
+        /* Otherwise not configured, or another slot is staged: stays
+           pending for the next DataIn / call */
+#if HID_EPIN_COUNT == 1
+        break;      /* Shared endpoint: one report per transfer */
+#endif
+    }
+    
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Check for reports not yet handed to the endpoint
+  */
+bool USBReport_IsPending(void)
+{
+    for (uint8_t i = 0; i < USB_REPORT_SLOTS; i++) {
+        if (slots[i].dirty) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+  * @brief  HID IN transfer complete: send the next pending report
+  * @note   Overrides the weak hook in usbd_hid.c (USB interrupt context).
+  */
+void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+    (void)pdev;
+    uint8_t index = HID_EPIN_INDEX(epnum);
+    
+    UsbFrame_ReportCollected(index);
+    UsbLatency_Collected(index);
+    
+    /* The class driver has just armed the staged report, if any */
+    if (index < HID_EPIN_COUNT && staged[index].slot != USB_REPORT_SLOT_NONE) {
+        staged[index].slot = USB_REPORT_SLOT_NONE;
+        UsbFrame_ReportLoaded(index, staged[index].time);
+        UsbLatency_Armed(index);
+    }
+    
+    USBReport_Flush();
+}
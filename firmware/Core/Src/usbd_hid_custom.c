@@ -9,8 +9,6 @@
 
 #include "usbd_hid_custom.h"
 
-#ifdef USE_JOYSTICK_MODE
-
 /**
   * @brief  Custom HID Report Descriptor for Dual Arcade Joystick
   *         - TWO separate Application Collections = 2 devices in Windows
@@ -91,5 +89,3 @@ const uint8_t HID_JOYSTICK_ReportDesc_Custom[HID_REPORT_DESC_SIZE_CUSTOM] = {
     
     0xC0               // END_COLLECTION (Application)
 };
-
-#endif /* USE_JOYSTICK_MODE */
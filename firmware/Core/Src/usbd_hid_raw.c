@@ -1,18 +1,18 @@
+/**
+  ******************************************************************************
+  * @file    usbd_hid_raw.c
+  * @author  HIDO Project
+  * @brief   Vendor-defined HID interface (raw 64-byte data channel)
+  ******************************************************************************
+  */
+
 #include "usbd_hid_raw.h"
+#include "usbd_hid.h"
+#include "usbd_ctlreq.h"
+#include "usbd_core.h"
 #include <string.h>
 
-/* reference to the full FS configuration descriptor defined in usbd_desc.c */
-extern uint8_t USBD_FS_CfgDesc[];
-
-/* Forward: return full FS configuration descriptor to the USB core */
-static uint8_t *USBD_HID_RAW_GetFSConfigDescriptor(uint16_t *length)
-{
-    /* wTotalLength for FS configuration: 73 bytes (0x49) matching USBD_FS_CfgDesc */
-    *length = 0x49;
-    return USBD_FS_CfgDesc;
-}
-
-// HID RAW Report Descriptor (Usage Page 0xFF00, 64 bytes)
+/* HID RAW Report Descriptor (Usage Page 0xFF00, 64 bytes in, 64 bytes out) */
 const uint8_t HID_RAW_ReportDesc[HID_RAW_REPORT_DESC_SIZE] = {
     0x06, 0x00, 0xFF,      // USAGE_PAGE (Vendor Defined 0xFF00)
     0x09, 0x01,            // USAGE (Vendor Usage 1)
@@ -28,31 +28,297 @@ const uint8_t HID_RAW_ReportDesc[HID_RAW_REPORT_DESC_SIZE] = {
     0xC0                   // END_COLLECTION
 };
 
-// Stub della classe USBD_HID_RAW (deve essere globale, non static)
+/* Interface, HID and endpoint descriptors; bInterfaceNumber is patched */
+static const uint8_t HID_RAW_IfDesc[USB_HID_RAW_IF_DESC_SIZ] = {
+    0x09, USB_DESC_TYPE_INTERFACE, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x00,
+    0x09, HID_DESCRIPTOR_TYPE, 0x11, 0x01, 0x00, 0x01, HID_REPORT_DESC,
+    HID_RAW_REPORT_DESC_SIZE, 0x00,
+    0x07, USB_DESC_TYPE_ENDPOINT, HID_RAW_EPIN_ADDR, 0x03,
+    HID_RAW_EPIN_SIZE, 0x00, HID_RAW_POLLING_INTERVAL,
+    0x07, USB_DESC_TYPE_ENDPOINT, HID_RAW_EPOUT_ADDR, 0x03,
+    HID_RAW_EPOUT_SIZE, 0x00, HID_RAW_POLLING_INTERVAL
+};
+
+#define HID_RAW_IF_NUM_IDX      2U      /* bInterfaceNumber */
+#define HID_RAW_HID_DESC_IDX    9U      /* HID descriptor inside HID_RAW_IfDesc */
+
+/* IN report queue, sent from the DataIn interrupt */
+static uint8_t tx_queue[HID_RAW_TX_QUEUE_SIZE][HID_RAW_REPORT_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static volatile uint8_t tx_busy = 0;
+
+/* OUT report being received */
+static uint8_t rx_buffer[HID_RAW_EPOUT_SIZE];
+static volatile uint8_t rx_held = 0;    /* rx_buffer waits for a free IN queue entry */
+static uint16_t rx_held_len = 0;
+
+/* HID class request state (must outlive the control IN transfer) */
+static uint8_t raw_idle = 0;
+static uint8_t raw_protocol = HID_PROTOCOL_REPORT;
+static uint8_t raw_alt = 0;
+
+static uint8_t USBD_HID_RAW_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_HID_RAW_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_HID_RAW_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_HID_RAW_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_HID_RAW_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+/* Raw interface callbacks (forwarded by USBD_HID, not registered itself) */
 USBD_ClassTypeDef USBD_HID_RAW = {
-    NULL, // Init
-    NULL, // DeInit
-    NULL, // Setup
-    NULL, // EP0_TxSent
-    NULL, // EP0_RxReady
-    NULL, // DataIn
-    NULL, // DataOut
-    NULL, // SOF
-    NULL, // IsoINIncomplete
-    NULL, // IsoOUTIncomplete
-    NULL, // GetHSConfigDescriptor
-    USBD_HID_RAW_GetFSConfigDescriptor, // GetFSConfigDescriptor
-    NULL, // GetOtherSpeedConfigDescriptor
-    NULL  // GetDeviceQualifierDescriptor
+    USBD_HID_RAW_Init,      // Init
+    USBD_HID_RAW_DeInit,    // DeInit
+    USBD_HID_RAW_Setup,     // Setup
+    NULL,                   // EP0_TxSent
+    NULL,                   // EP0_RxReady
+    USBD_HID_RAW_DataIn,    // DataIn
+    USBD_HID_RAW_DataOut,   // DataOut
+    NULL,                   // SOF
+    NULL,                   // IsoINIncomplete
+    NULL,                   // IsoOUTIncomplete
+    NULL,                   // GetHSConfigDescriptor
+    NULL,                   // GetFSConfigDescriptor
+    NULL,                   // GetOtherSpeedConfigDescriptor
+    NULL                    // GetDeviceQualifierDescriptor
 };
 
-// API di base (stub)
-uint8_t USBD_HID_RAW_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len) {
-    // TODO: implementare invio report RAW
-    return 0;
+/**
+  * @brief  Check for a free IN queue entry
+  */
+static uint8_t USBD_HID_RAW_TxFree(void)
+{
+    return (uint8_t)(((tx_head + 1U) & (HID_RAW_TX_QUEUE_SIZE - 1U)) != tx_tail);
+}
+
+/**
+  * @brief  Start the next queued IN report if the endpoint is free
+  * @note   Call with interrupts masked or from the USB interrupt.
+  */
+static void USBD_HID_RAW_Kick(USBD_HandleTypeDef *pdev)
+{
+    if (tx_busy || tx_head == tx_tail) {
+        return;
+    }
+
+    /* The report is copied into PMA here, so its queue entry is free again */
+    tx_busy = 1;
+    USBD_LL_Transmit(pdev, HID_RAW_EPIN_ADDR, tx_queue[tx_tail], HID_RAW_REPORT_SIZE);
+    tx_tail = (uint8_t)((tx_tail + 1U) & (HID_RAW_TX_QUEUE_SIZE - 1U));
+}
+
+/**
+  * @brief  Open the raw endpoints
+  */
+static uint8_t USBD_HID_RAW_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+    (void)cfgidx;
+
+    USBD_LL_OpenEP(pdev, HID_RAW_EPIN_ADDR, USBD_EP_TYPE_INTR, HID_RAW_EPIN_SIZE);
+    pdev->ep_in[HID_RAW_EPIN_ADDR & 0xFU].is_used = 1U;
+    USBD_LL_OpenEP(pdev, HID_RAW_EPOUT_ADDR, USBD_EP_TYPE_INTR, HID_RAW_EPOUT_SIZE);
+    pdev->ep_out[HID_RAW_EPOUT_ADDR & 0xFU].is_used = 1U;
+
+    tx_head = 0;
+    tx_tail = 0;
+    tx_busy = 0;
+    rx_held = 0;
+    raw_protocol = HID_PROTOCOL_REPORT;
+
+    return USBD_HID_RAW_ReceivePacket(pdev, rx_buffer, sizeof(rx_buffer));
+}
+
+/**
+  * @brief  Close the raw endpoints
+  */
+static uint8_t USBD_HID_RAW_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+    (void)cfgidx;
+
+    USBD_LL_CloseEP(pdev, HID_RAW_EPIN_ADDR);
+    pdev->ep_in[HID_RAW_EPIN_ADDR & 0xFU].is_used = 0U;
+    USBD_LL_CloseEP(pdev, HID_RAW_EPOUT_ADDR);
+    pdev->ep_out[HID_RAW_EPOUT_ADDR & 0xFU].is_used = 0U;
+
+    tx_busy = 0;
+    return USBD_OK;
+}
+
+/**
+  * @brief  Standard and class requests addressed to the raw interface
+  */
+static uint8_t USBD_HID_RAW_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+    uint16_t len;
+
+    switch (req->bmRequest & USB_REQ_TYPE_MASK)
+    {
+        case USB_REQ_TYPE_CLASS:
+            switch (req->bRequest)
+            {
+                case HID_REQ_SET_PROTOCOL:
+                    raw_protocol = (uint8_t)req->wValue;
+                    return USBD_OK;
+                case HID_REQ_GET_PROTOCOL:
+                    USBD_CtlSendData(pdev, &raw_protocol, 1U);
+                    return USBD_OK;
+                case HID_REQ_SET_IDLE:
+                    raw_idle = (uint8_t)(req->wValue >> 8);
+                    return USBD_OK;
+                case HID_REQ_GET_IDLE:
+                    USBD_CtlSendData(pdev, &raw_idle, 1U);
+                    return USBD_OK;
+                default:
+                    break;
+            }
+            break;
+
+        case USB_REQ_TYPE_STANDARD:
+            switch (req->bRequest)
+            {
+                case USB_REQ_GET_DESCRIPTOR:
+                    if (req->wValue >> 8 == HID_REPORT_DESC) {
+                        len = MIN(HID_RAW_REPORT_DESC_SIZE, req->wLength);
+                        USBD_CtlSendData(pdev, (uint8_t *)HID_RAW_ReportDesc, len);
+                        return USBD_OK;
+                    }
+                    if (req->wValue >> 8 == HID_DESCRIPTOR_TYPE) {
+                        len = MIN(USB_HID_DESC_SIZ, req->wLength);
+                        USBD_CtlSendData(pdev, (uint8_t *)&HID_RAW_IfDesc[HID_RAW_HID_DESC_IDX], len);
+                        return USBD_OK;
+                    }
+                    break;
+                case USB_REQ_GET_INTERFACE:
+                    USBD_CtlSendData(pdev, &raw_alt, 1U);
+                    return USBD_OK;
+                case USB_REQ_SET_INTERFACE:
+                    return USBD_OK;
+                default:
+                    break;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    USBD_CtlError(pdev, req);
+    return USBD_FAIL;
+}
+
+/**
+  * @brief  IN report collected: send the next queued one
+  */
+static uint8_t USBD_HID_RAW_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+    (void)epnum;
+
+    tx_busy = 0;
+    USBD_HID_RAW_Kick(pdev);
+
+    /* A command held back for want of a reply slot can run now */
+    if (rx_held && USBD_HID_RAW_TxFree()) {
+        rx_held = 0;
+        USBD_HID_RAW_ReceiveCallback(pdev, rx_buffer, rx_held_len);
+        return USBD_HID_RAW_ReceivePacket(pdev, rx_buffer, sizeof(rx_buffer));
+    }
+    return USBD_OK;
+}
+
+/**
+  * @brief  OUT report received: hand it over and re-arm the endpoint
+  * @note   With the IN queue full the report is held and the endpoint left
+  *         NAKing until DataIn frees an entry, so every command gets room
+  *         for its reply.
+  */
+static uint8_t USBD_HID_RAW_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+    uint16_t len = (uint16_t)USBD_LL_GetRxDataSize(pdev, epnum);
+
+    if (!USBD_HID_RAW_TxFree()) {
+        rx_held = 1;
+        rx_held_len = len;
+        return USBD_OK;
+    }
+
+    USBD_HID_RAW_ReceiveCallback(pdev, rx_buffer, len);
+    return USBD_HID_RAW_ReceivePacket(pdev, rx_buffer, sizeof(rx_buffer));
 }
 
-uint8_t USBD_HID_RAW_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len) {
-    // TODO: implementare ricezione RAW
-    return 0;
+/**
+  * @brief  Write the raw interface into a configuration descriptor
+  * @param  desc: Destination (USB_HID_RAW_IF_DESC_SIZ bytes)
+  * @param  intf: bInterfaceNumber
+  * @retval Bytes written
+  */
+uint16_t USBD_HID_RAW_WriteIfDesc(uint8_t *desc, uint8_t intf)
+{
+    memcpy(desc, HID_RAW_IfDesc, USB_HID_RAW_IF_DESC_SIZ);
+    desc[HID_RAW_IF_NUM_IDX] = intf;
+    return USB_HID_RAW_IF_DESC_SIZ;
+}
+
+/**
+  * @brief  Queue one IN report
+  * @param  report: Report data, zero-padded to HID_RAW_REPORT_SIZE
+  * @param  len: Data length (at most HID_RAW_REPORT_SIZE)
+  * @retval USBD_OK if queued, USBD_BUSY if the queue is full,
+  *         USBD_FAIL if the device is not configured
+  * @note   Safe from main loop and interrupt context.
+  */
+uint8_t USBD_HID_RAW_SendReport(USBD_HandleTypeDef *pdev, uint8_t *report, uint16_t len)
+{
+    if (pdev->dev_state != USBD_STATE_CONFIGURED || len > HID_RAW_REPORT_SIZE) {
+        return USBD_FAIL;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t next = (uint8_t)((tx_head + 1U) & (HID_RAW_TX_QUEUE_SIZE - 1U));
+    if (next == tx_tail) {
+        __set_PRIMASK(primask);
+        return USBD_BUSY;
+    }
+
+    memcpy(tx_queue[tx_head], report, len);
+    memset(&tx_queue[tx_head][len], 0, HID_RAW_REPORT_SIZE - len);
+    tx_head = next;
+    USBD_HID_RAW_Kick(pdev);
+
+    __set_PRIMASK(primask);
+    return USBD_OK;
+}
+
+/**
+  * @brief  Check whether every queued IN report has been collected
+  * @note   Safe from main loop and interrupt context.
+  */
+uint8_t USBD_HID_RAW_TxIdle(void)
+{
+    return (uint8_t)(tx_head == tx_tail && !tx_busy);
+}
+
+/**
+  * @brief  Arm the OUT endpoint for the next report
+  * @param  buf: Receive buffer (at least HID_RAW_EPOUT_SIZE bytes)
+  * @param  len: Buffer size
+  * @retval USBD status
+  */
+uint8_t USBD_HID_RAW_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len)
+{
+    return USBD_LL_PrepareReceive(pdev, HID_RAW_EPOUT_ADDR, buf, len);
+}
+
+/**
+  * @brief  An OUT report has been received
+  * @param  buf: Report data, valid until this function returns
+  * @param  len: Report length
+  * @note   Weak: overridden by the command handler (usb_commands.c).
+  *         USB interrupt context.
+  */
+__weak void USBD_HID_RAW_ReceiveCallback(USBD_HandleTypeDef *pdev, uint8_t *buf, uint16_t len)
+{
+    (void)pdev;
+    (void)buf;
+    (void)len;
 }
@@ -27,6 +27,7 @@ extern "C" {
 
 /* Includes ------------------------------------------------------------------*/
 #include  "usbd_ioreq.h"
+#include  "usbd_hid_raw.h"
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
   * @{
@@ -42,27 +43,49 @@ extern "C" {
   * @{
   */
 
-/* Mode selection - uncomment only ONE */
-//#define USE_KEYBOARD_MODE    // NKRO Keyboard mode
-//#define USE_JOYSTICK_MODE  // Arcade Joystick mode
-//#define USE_JVS_MODE       // JVS protocol mode
-
-#ifdef USE_KEYBOARD_MODE
-  #define HID_EPIN_SIZE                 0x09U  // 1 ReportID + 1 Modifier + 1 Reserved + 6 Keys = 9 bytes
-  #define HID_REPORT_DESC_SIZE          47U    // Standard 6KRO keyboard descriptor size
-#elif defined(USE_JOYSTICK_MODE)
-  #define HID_EPIN_SIZE                 0x06U  // 5 bytes: Report ID + 2 axes + 2 bytes buttons
-  #define HID_REPORT_DESC_SIZE          102U   // Dual joystick (2 Application Collections = 2 devices)
-#elif defined(USE_JVS_MODE)
-  #define HID_EPIN_SIZE                 0x40U  // 64 bytes for JVS
-  #define HID_REPORT_DESC_SIZE          0U     // JVS uses custom protocol
+/* Per-mode interface parameters. All modes are built in; the configuration
+   descriptors are patched for the mode selected at boot (see
+   USBD_HID_SetDeviceMode) */
+#define HID_KEYBOARD_EPIN_SIZE          0x12U  // 1 ReportID + 1 Modifier + 16 bytes key bitmap = 18 bytes
+#define HID_KEYBOARD_REPORT_DESC_SIZE   33U    // NKRO bitmap keyboard descriptor size
+#define HID_KEYBOARD_SUBCLASS           0x01U  // Boot interface: BIOS can use the boot protocol
+#define HID_KEYBOARD_PROTOCOL           0x01U  // Keyboard
+
+#define HID_JOYSTICK_EPIN_SIZE          0x06U  // 5 bytes: Report ID + 2 axes + 2 bytes buttons
+#define HID_JOYSTICK_REPORT_DESC_SIZE   102U   // Dual joystick (2 Application Collections = 2 devices)
+#define HID_PLAYER_REPORT_DESC_SIZE     51U    // One player's Application Collection
+
+#define HID_JVS_EPIN_SIZE               0x40U  // 64 bytes for JVS
+#define HID_JVS_REPORT_DESC_SIZE        0U     // JVS uses custom protocol
+
+#define HID_EPIN_SIZE                   0x40U  // Largest IN packet of any mode (report buffers)
+
+#ifndef HID_JOYSTICK_DUAL_EP
+  #define HID_JOYSTICK_DUAL_EP          0      // 1 = one interface + IN endpoint per player (joystick mode)
+#endif
+
+/* With HID_JOYSTICK_DUAL_EP each player is a separate interface with its own
+   IN endpoint, so both reports can be collected in the same frame. This is
+   the most interfaces any mode uses; the other modes present only the first */
+#if HID_JOYSTICK_DUAL_EP
+  #define HID_NUM_INTERFACES          2U
 #else
-  #error "Please define one mode: USE_KEYBOARD_MODE, USE_JOYSTICK_MODE, or USE_JVS_MODE"
+  #define HID_NUM_INTERFACES          1U
 #endif
 
 #define HID_EPIN_ADDR                 0x81U
-
-#define USB_HID_CONFIG_DESC_SIZ       34U
+#define HID_EPIN2_ADDR                0x82U  // Player 2 interface (HID_JOYSTICK_DUAL_EP)
+#define HID_EPIN_COUNT                HID_NUM_INTERFACES
+#define HID_EPIN_INDEX(ep)            (((ep) & 0x0FU) - (HID_EPIN_ADDR & 0x0FU))
+
+#define USB_HID_IF_DESC_SIZ           25U    // Interface + HID + endpoint descriptors
+#define USB_HID_CONFIG_DESC_SIZ       (9U + (HID_NUM_INTERFACES * USB_HID_IF_DESC_SIZ) + USB_HID_RAW_IF_DESC_SIZ)  // + vendor data interface
+#define HID_CFG_HID_DESC_IDX          18U    // Offset of the first HID descriptor in the configuration descriptor
+#define HID_CFG_SUBCLASS_IDX          15U    // Offset of the first bInterfaceSubClass
+#define HID_CFG_PROTOCOL_IDX          16U    // Offset of the first bInterfaceProtocol
+#define HID_CFG_REPORT_LEN_IDX        25U    // Offset of the first wItemLength
+#define HID_CFG_EPIN_SIZE_IDX         31U    // Offset of the first wMaxPacketSize
+#define HID_CFG_BINTERVAL_IDX         33U    // Offset of the first bInterval in the configuration descriptor
 #define USB_HID_DESC_SIZ              9U
 #define HID_MOUSE_REPORT_DESC_SIZE    74U
 
@@ -80,6 +103,9 @@ extern "C" {
 #define HID_REQ_SET_PROTOCOL          0x0BU
 #define HID_REQ_GET_PROTOCOL          0x03U
 
+#define HID_PROTOCOL_BOOT             0x00U
+#define HID_PROTOCOL_REPORT           0x01U
+
 #define HID_REQ_SET_IDLE              0x0AU
 #define HID_REQ_GET_IDLE              0x02U
 
@@ -106,7 +132,8 @@ typedef struct
   uint32_t             Protocol;
   uint32_t             IdleState;
   uint32_t             AltSetting;
-  HID_StateTypeDef     state;
+  HID_StateTypeDef     state[HID_EPIN_COUNT];
+  uint16_t             staged_len[HID_EPIN_COUNT];  /* Report waiting in the idle PMA buffer, 0 if none */
 }
 USBD_HID_HandleTypeDef;
 /**
@@ -139,8 +166,27 @@ extern USBD_ClassTypeDef  USBD_HID;
 uint8_t USBD_HID_SendReport(USBD_HandleTypeDef *pdev,
                             uint8_t *report,
                             uint16_t len);
+uint8_t USBD_HID_SendReportEP(USBD_HandleTypeDef *pdev,
+                              uint8_t ep_addr,
+                              uint8_t *report,
+                              uint16_t len);
+uint8_t USBD_HID_StageReportEP(USBD_HandleTypeDef *pdev,
+                               uint8_t ep_addr,
+                               uint8_t *report,
+                               uint16_t len);
+volatile uint16_t *USBD_HID_GetReportBufferEP(USBD_HandleTypeDef *pdev,
+                                              uint8_t ep_addr,
+                                              uint16_t len);
+uint8_t USBD_HID_CommitReportEP(USBD_HandleTypeDef *pdev,
+                                uint8_t ep_addr,
+                                uint16_t len);
 
 uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev);
+void USBD_HID_SetPollingInterval(uint8_t interval_ms);
+void USBD_HID_SetDeviceMode(uint8_t mode);
+uint8_t USBD_HID_GetProtocol(USBD_HandleTypeDef *pdev);
+void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev, uint8_t epnum);
+void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev);
 
 /**
   * @}
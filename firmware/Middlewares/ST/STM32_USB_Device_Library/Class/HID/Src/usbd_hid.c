@@ -47,10 +47,9 @@ EndBSPDependencies */
 #include "usbd_hid.h"
 #include "usbd_ctlreq.h"
 #include "usb_commands.h"  /* Vendor-specific commands (bootloader, version, etc.) */
-
-#ifdef USE_JOYSTICK_MODE
+#include "device_mode.h"
 #include "usbd_hid_custom.h"
-#endif
+#include "usbd_hid_raw.h"      /* Vendor data interface, served by this class */
 
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
@@ -115,6 +114,12 @@ static uint8_t  *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length);
 static uint8_t  *USBD_HID_GetDeviceQualifierDesc(uint16_t *length);
 
 static uint8_t  USBD_HID_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+static uint8_t  USBD_HID_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+static uint8_t  USBD_HID_SOF(USBD_HandleTypeDef *pdev);
+
+static uint16_t USBD_HID_PatchCfgDesc(uint8_t *desc, uint8_t binterval);
 /**
   * @}
   */
@@ -131,8 +136,8 @@ USBD_ClassTypeDef  USBD_HID =
   NULL, /*EP0_TxSent*/
   USBD_HID_EP0_RxReady, /*EP0_RxReady*/
   USBD_HID_DataIn, /*DataIn*/
-  NULL, /*DataOut*/
-  NULL, /*SOF */
+  USBD_HID_DataOut, /*DataOut*/
+  USBD_HID_SOF, /*SOF */
   NULL,
   NULL,
   USBD_HID_GetHSCfgDesc,
@@ -141,6 +146,29 @@ USBD_ClassTypeDef  USBD_HID =
   USBD_HID_GetDeviceQualifierDesc,
 };
 
+/* Full-speed bInterval in ms, patched into the configuration descriptors
+   each time the host reads them (see USBD_HID_SetPollingInterval) */
+static uint8_t hid_fs_binterval = HID_FS_BINTERVAL;
+
+/* Interface parameters of the device mode, patched into the configuration
+   descriptors each time the host reads them (see USBD_HID_SetDeviceMode) */
+static uint8_t hid_num_interfaces = 1U;
+static uint8_t hid_subclass = 0x00U;
+static uint8_t hid_protocol = 0x00U;
+static uint8_t hid_epin_size = HID_JVS_EPIN_SIZE;
+static uint16_t hid_if_report_desc_size = HID_JVS_REPORT_DESC_SIZE;
+static uint8_t *hid_report_desc = NULL;
+
+/* Player 2 interface, appended to the configuration descriptors when
+   HID_JOYSTICK_DUAL_EP is set (interface 1, endpoint HID_EPIN2_ADDR) and
+   only reported to the host in joystick mode */
+#define HID_PLAYER2_IF_DESC(binterval)                                          \
+  0x09, USB_DESC_TYPE_INTERFACE, 0x01, 0x00, 0x01, 0x03, 0x00, 0x00, 0,         \
+  0x09, HID_DESCRIPTOR_TYPE, 0x11, 0x01, 0x00, 0x01, 0x22,                      \
+  HID_PLAYER_REPORT_DESC_SIZE, 0x00,                                            \
+  0x07, USB_DESC_TYPE_ENDPOINT, HID_EPIN2_ADDR, 0x03, HID_JOYSTICK_EPIN_SIZE,   \
+  0x00, (binterval)
+
 /* USB HID device FS Configuration Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_HID_CfgFSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIGN_END =
 {
@@ -149,7 +177,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgFSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   USB_HID_CONFIG_DESC_SIZ,
   /* wTotalLength: Bytes returned */
   0x00,
-  0x01,         /*bNumInterfaces: 1 interface*/
+  HID_NUM_INTERFACES, /*bNumInterfaces: patched per mode (2 in joystick mode with HID_JOYSTICK_DUAL_EP)*/
   0x01,         /*bConfigurationValue: Configuration value*/
   0x00,         /*iConfiguration: Index of string descriptor describing
   the configuration*/
@@ -164,8 +192,8 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgFSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   0x00,         /*bAlternateSetting: Alternate setting*/
   0x01,         /*bNumEndpoints*/
   0x03,         /*bInterfaceClass: HID*/
-  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
-  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot (patched per mode)*/
+  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse (patched per mode)*/
   0,            /*iInterface: Index of string descriptor*/
   /******************** Descriptor of Joystick HID ********************/
   /* 18 */
@@ -176,7 +204,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgFSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   0x00,         /*bCountryCode: Hardware target country*/
   0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
   0x22,         /*bDescriptorType*/
-  HID_REPORT_DESC_SIZE,/*wItemLength: Total length of Report descriptor*/
+  0x00,         /*wItemLength: Total length of Report descriptor (patched per mode)*/
   0x00,
   /******************** Descriptor of Joystick endpoint ********************/
   /* 27 */
@@ -185,10 +213,14 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgFSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
 
   HID_EPIN_ADDR,     /*bEndpointAddress: Endpoint Address (IN)*/
   0x03,          /*bmAttributes: Interrupt endpoint*/
-  HID_EPIN_SIZE, /*wMaxPacketSize: 3 Byte max */
+  HID_EPIN_SIZE, /*wMaxPacketSize: patched per mode */
   0x00,
   HID_FS_BINTERVAL,          /*bInterval: Polling Interval */
   /* 34 */
+#if HID_NUM_INTERFACES > 1
+  HID_PLAYER2_IF_DESC(HID_FS_BINTERVAL),
+  /* 59 */
+#endif
 };
 
 /* USB HID device Device Qualifier descriptor */
@@ -199,7 +231,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgHSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   USB_HID_CONFIG_DESC_SIZ,
   /* wTotalLength: Bytes returned */
   0x00,
-  0x01,         /*bNumInterfaces: 1 interface*/
+  HID_NUM_INTERFACES, /*bNumInterfaces: patched per mode (2 in joystick mode with HID_JOYSTICK_DUAL_EP)*/
   0x01,         /*bConfigurationValue: Configuration value*/
   0x00,         /*iConfiguration: Index of string descriptor describing
   the configuration*/
@@ -214,8 +246,8 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgHSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   0x00,         /*bAlternateSetting: Alternate setting*/
   0x01,         /*bNumEndpoints*/
   0x03,         /*bInterfaceClass: HID*/
-  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
-  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot (patched per mode)*/
+  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse (patched per mode)*/
   0,            /*iInterface: Index of string descriptor*/
   /******************** Descriptor of Joystick HID ********************/
   /* 18 */
@@ -226,7 +258,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgHSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
   0x00,         /*bCountryCode: Hardware target country*/
   0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
   0x22,         /*bDescriptorType*/
-  HID_REPORT_DESC_SIZE,/*wItemLength: Total length of Report descriptor*/
+  0x00,         /*wItemLength: Total length of Report descriptor (patched per mode)*/
   0x00,
   /******************** Descriptor of Joystick endpoint ********************/
   /* 27 */
@@ -235,10 +267,14 @@ __ALIGN_BEGIN static uint8_t USBD_HID_CfgHSDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIG
 
   HID_EPIN_ADDR,     /*bEndpointAddress: Endpoint Address (IN)*/
   0x03,          /*bmAttributes: Interrupt endpoint*/
-  HID_EPIN_SIZE, /*wMaxPacketSize: 3 Byte max */
+  HID_EPIN_SIZE, /*wMaxPacketSize: patched per mode */
   0x00,
   HID_HS_BINTERVAL,          /*bInterval: Polling Interval */
   /* 34 */
+#if HID_NUM_INTERFACES > 1
+  HID_PLAYER2_IF_DESC(HID_HS_BINTERVAL),
+  /* 59 */
+#endif
 };
 
 /* USB HID device Other Speed Configuration Descriptor */
@@ -249,7 +285,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_OtherSpeedCfgDesc[USB_HID_CONFIG_DESC_SIZ]
   USB_HID_CONFIG_DESC_SIZ,
   /* wTotalLength: Bytes returned */
   0x00,
-  0x01,         /*bNumInterfaces: 1 interface*/
+  HID_NUM_INTERFACES, /*bNumInterfaces: patched per mode (2 in joystick mode with HID_JOYSTICK_DUAL_EP)*/
   0x01,         /*bConfigurationValue: Configuration value*/
   0x00,         /*iConfiguration: Index of string descriptor describing
   the configuration*/
@@ -264,8 +300,8 @@ __ALIGN_BEGIN static uint8_t USBD_HID_OtherSpeedCfgDesc[USB_HID_CONFIG_DESC_SIZ]
   0x00,         /*bAlternateSetting: Alternate setting*/
   0x01,         /*bNumEndpoints*/
   0x03,         /*bInterfaceClass: HID*/
-  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
-  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+  0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot (patched per mode)*/
+  0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse (patched per mode)*/
   0,            /*iInterface: Index of string descriptor*/
   /******************** Descriptor of Joystick Mouse HID ********************/
   /* 18 */
@@ -276,7 +312,7 @@ __ALIGN_BEGIN static uint8_t USBD_HID_OtherSpeedCfgDesc[USB_HID_CONFIG_DESC_SIZ]
   0x00,         /*bCountryCode: Hardware target country*/
   0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
   0x22,         /*bDescriptorType*/
-  HID_MOUSE_REPORT_DESC_SIZE,/*wItemLength: Total length of Report descriptor*/
+  0x00,         /*wItemLength: Total length of Report descriptor (patched per mode)*/
   0x00,
   /******************** Descriptor of Mouse endpoint ********************/
   /* 27 */
@@ -285,28 +321,17 @@ __ALIGN_BEGIN static uint8_t USBD_HID_OtherSpeedCfgDesc[USB_HID_CONFIG_DESC_SIZ]
 
   HID_EPIN_ADDR,     /*bEndpointAddress: Endpoint Address (IN)*/
   0x03,          /*bmAttributes: Interrupt endpoint*/
-  HID_EPIN_SIZE, /*wMaxPacketSize: 4 Byte max */
+  HID_EPIN_SIZE, /*wMaxPacketSize: patched per mode */
   0x00,
   HID_FS_BINTERVAL,          /*bInterval: Polling Interval */
   /* 34 */
+#if HID_NUM_INTERFACES > 1
+  HID_PLAYER2_IF_DESC(HID_FS_BINTERVAL),
+  /* 59 */
+#endif
 };
 
 
-/* USB HID device Configuration Descriptor */
-__ALIGN_BEGIN static uint8_t USBD_HID_Desc[USB_HID_DESC_SIZ]  __ALIGN_END  =
-{
-  /* 18 */
-  0x09,         /*bLength: HID Descriptor size*/
-  HID_DESCRIPTOR_TYPE, /*bDescriptorType: HID*/
-  0x11,         /*bcdHID: HID Class Spec release number*/
-  0x01,
-  0x00,         /*bCountryCode: Hardware target country*/
-  0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
-  0x22,         /*bDescriptorType*/
-  HID_MOUSE_REPORT_DESC_SIZE,/*wItemLength: Total length of Report descriptor*/
-  0x00,
-};
-
 /* USB Standard Device Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_HID_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC]  __ALIGN_END =
 {
@@ -324,9 +349,8 @@ __ALIGN_BEGIN static uint8_t USBD_HID_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
 
 /* HID Report Descriptors for different modes */
 
-#ifdef USE_KEYBOARD_MODE
-/* Standard 6-Key Rollover Keyboard Descriptor */
-__ALIGN_BEGIN static uint8_t HID_KEYBOARD_ReportDesc[HID_REPORT_DESC_SIZE] __ALIGN_END =
+/* NKRO Keyboard Descriptor: modifier byte + one bit per usage 0x00-0x7F */
+__ALIGN_BEGIN static uint8_t HID_KEYBOARD_ReportDesc[HID_KEYBOARD_REPORT_DESC_SIZE] __ALIGN_END =
 {
     0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
     0x09, 0x06,                    // USAGE (Keyboard)
@@ -343,28 +367,18 @@ __ALIGN_BEGIN static uint8_t HID_KEYBOARD_ReportDesc[HID_REPORT_DESC_SIZE] __ALI
     0x95, 0x08,                    //   REPORT_COUNT (8)
     0x81, 0x02,                    //   INPUT (Data,Var,Abs)
     
-    // Reserved byte
-    0x95, 0x01,                    //   REPORT_COUNT (1)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
-    0x81, 0x01,                    //   INPUT (Const,Ary,Abs)
-    
-    // 6 key array
-    0x05, 0x07,                    //   USAGE_PAGE (Keyboard/Keypad)
+    // Key bitmap (16 bytes)
     0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
-    0x29, 0x65,                    //   USAGE_MAXIMUM (Keyboard Application)
-    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-    0x25, 0x65,                    //   LOGICAL_MAXIMUM (101)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
-    0x95, 0x06,                    //   REPORT_COUNT (6)
-    0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
+    0x29, 0x7F,                    //   USAGE_MAXIMUM (Keyboard Mute)
+    0x95, 0x80,                    //   REPORT_COUNT (128)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
     
     0xC0                           // END_COLLECTION
 };
-#endif
 
-#ifdef USE_JOYSTICK_MODE
+#ifndef HID_REPORT_DESC_SIZE_CUSTOM
 /* Dual Joystick - TWO Application Collections (2 separate devices in Windows) */
-__ALIGN_BEGIN static uint8_t HID_JOYSTICK_ReportDesc[HID_REPORT_DESC_SIZE] __ALIGN_END =
+__ALIGN_BEGIN static uint8_t HID_JOYSTICK_ReportDesc[HID_JOYSTICK_REPORT_DESC_SIZE] __ALIGN_END =
 {
     /* ===== PLAYER 1 - Separate Application Collection ===== */
     0x05, 0x01,        // USAGE_PAGE (Generic Desktop)
@@ -438,10 +452,8 @@ __ALIGN_BEGIN static uint8_t HID_JOYSTICK_ReportDesc[HID_REPORT_DESC_SIZE] __ALI
 };
 #endif
 
-#ifdef USE_JVS_MODE
 /* JVS mode doesn't use HID report descriptor */
 __ALIGN_BEGIN static uint8_t HID_JVS_ReportDesc[1] __ALIGN_END = {0x00};
-#endif
 
 /**
   * @}
@@ -461,9 +473,21 @@ __ALIGN_BEGIN static uint8_t HID_JVS_ReportDesc[1] __ALIGN_END = {0x00};
 static uint8_t  USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   /* Open EP IN */
-  USBD_LL_OpenEP(pdev, HID_EPIN_ADDR, USBD_EP_TYPE_INTR, HID_EPIN_SIZE);
+  USBD_LL_OpenEP(pdev, HID_EPIN_ADDR, USBD_EP_TYPE_INTR, hid_epin_size);
   pdev->ep_in[HID_EPIN_ADDR & 0xFU].is_used = 1U;
 
+#if HID_EPIN_COUNT > 1
+  if (hid_num_interfaces > 1U)
+  {
+    /* Player 2 interface endpoint */
+    USBD_LL_OpenEP(pdev, HID_EPIN2_ADDR, USBD_EP_TYPE_INTR, hid_epin_size);
+    pdev->ep_in[HID_EPIN2_ADDR & 0xFU].is_used = 1U;
+  }
+#endif
+
+  /* Vendor data interface endpoints */
+  USBD_HID_RAW.Init(pdev, cfgidx);
+
   pdev->pClassData = USBD_malloc(sizeof(USBD_HID_HandleTypeDef));
 
   if (pdev->pClassData == NULL)
@@ -471,7 +495,14 @@ static uint8_t  USBD_HID_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     return USBD_FAIL;
   }
 
-  ((USBD_HID_HandleTypeDef *)pdev->pClassData)->state = HID_IDLE;
+  for (uint8_t i = 0U; i < HID_EPIN_COUNT; i++)
+  {
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->state[i] = HID_IDLE;
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->staged_len[i] = 0U;
+  }
+
+  /* HID devices start in report protocol; a BIOS switches to boot protocol */
+  ((USBD_HID_HandleTypeDef *)pdev->pClassData)->Protocol = HID_PROTOCOL_REPORT;
 
   return USBD_OK;
 }
@@ -489,6 +520,14 @@ static uint8_t  USBD_HID_DeInit(USBD_HandleTypeDef *pdev,
   /* Close HID EPs */
   USBD_LL_CloseEP(pdev, HID_EPIN_ADDR);
   pdev->ep_in[HID_EPIN_ADDR & 0xFU].is_used = 0U;
+#if HID_EPIN_COUNT > 1
+  if (hid_num_interfaces > 1U)
+  {
+    USBD_LL_CloseEP(pdev, HID_EPIN2_ADDR);
+    pdev->ep_in[HID_EPIN2_ADDR & 0xFU].is_used = 0U;
+  }
+#endif
+  USBD_HID_RAW.DeInit(pdev, cfgidx);
 
   /* FRee allocated memory */
   if (pdev->pClassData != NULL)
@@ -514,8 +553,17 @@ static uint8_t  USBD_HID_Setup(USBD_HandleTypeDef *pdev,
   uint16_t len = 0U;
   uint8_t *pbuf = NULL;
   uint16_t status_info = 0U;
+  uint8_t interface = LOBYTE(req->wIndex);
   USBD_StatusTypeDef ret = USBD_OK;
 
+  /* Standard/class requests to the vendor data interface */
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE &&
+      (req->bmRequest & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_VENDOR &&
+      interface == hid_num_interfaces)
+  {
+    return USBD_HID_RAW.Setup(pdev, req);
+  }
+
   switch (req->bmRequest & USB_REQ_TYPE_MASK)
   {
     case USB_REQ_TYPE_CLASS :
@@ -559,28 +607,25 @@ static uint8_t  USBD_HID_Setup(USBD_HandleTypeDef *pdev,
           break;
 
         case USB_REQ_GET_DESCRIPTOR:
+          if ((req->wValue >> 8 == HID_REPORT_DESC || req->wValue >> 8 == HID_DESCRIPTOR_TYPE) &&
+              interface >= hid_num_interfaces)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+            break;
+          }
+          
           if (req->wValue >> 8 == HID_REPORT_DESC)
           {
-#ifdef USE_KEYBOARD_MODE
-            len = MIN(HID_REPORT_DESC_SIZE, req->wLength);
-            pbuf = HID_KEYBOARD_ReportDesc;
-#elif defined(USE_JOYSTICK_MODE)
-            /* Prefer project's custom joystick descriptor when available */
-#ifdef HID_REPORT_DESC_SIZE_CUSTOM
-            len = MIN(HID_REPORT_DESC_SIZE_CUSTOM, req->wLength);
-            pbuf = (uint8_t *)HID_JOYSTICK_ReportDesc_Custom;
-#else
-            len = MIN(HID_REPORT_DESC_SIZE, req->wLength);
-            pbuf = HID_JOYSTICK_ReportDesc;
-#endif
-#elif defined(USE_JVS_MODE)
-            len = MIN(HID_REPORT_DESC_SIZE, req->wLength);
-            pbuf = HID_JVS_ReportDesc;
-#endif
+            /* With one interface per player, player N gets the Nth
+               Application Collection of the joystick descriptor */
+            len = MIN(hid_if_report_desc_size, req->wLength);
+            pbuf = hid_report_desc + (interface * hid_if_report_desc_size);
           }
           else if (req->wValue >> 8 == HID_DESCRIPTOR_TYPE)
           {
-            pbuf = USBD_HID_Desc;
+            /* Same HID descriptor as the one embedded in the configuration */
+            pbuf = USBD_HID_CfgFSDesc + HID_CFG_HID_DESC_IDX + (interface * USB_HID_IF_DESC_SIZ);
             len = MIN(USB_HID_DESC_SIZ, req->wLength);
           }
           else
@@ -639,28 +684,145 @@ static uint8_t  USBD_HID_Setup(USBD_HandleTypeDef *pdev,
 
 /**
   * @brief  USBD_HID_SendReport
-  *         Send HID Report
+  *         Send HID Report on the first IN endpoint
   * @param  pdev: device instance
   * @param  buff: pointer to report
-  * @retval status
+  * @retval USBD_OK if the transfer was started, USBD_BUSY if the endpoint
+  *         is still sending, USBD_FAIL if the device is not configured
   */
 uint8_t USBD_HID_SendReport(USBD_HandleTypeDef  *pdev,
                             uint8_t *report,
                             uint16_t len)
+{
+  return USBD_HID_SendReportEP(pdev, HID_EPIN_ADDR, report, len);
+}
+
+/**
+  * @brief  USBD_HID_SendReportEP
+  *         Send HID Report on a given IN endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: HID_EPIN_ADDR, or HID_EPIN2_ADDR with HID_JOYSTICK_DUAL_EP
+  * @param  buff: pointer to report
+  * @retval USBD_OK if the transfer was started, USBD_BUSY if the endpoint
+  *         is still sending, USBD_FAIL if the device is not configured
+  */
+uint8_t USBD_HID_SendReportEP(USBD_HandleTypeDef  *pdev,
+                              uint8_t ep_addr,
+                              uint8_t *report,
+                              uint16_t len)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef *)pdev->pClassData;
+  uint8_t index = HID_EPIN_INDEX(ep_addr);
+
+  if (pdev->dev_state != USBD_STATE_CONFIGURED || index >= hid_num_interfaces)
+  {
+    return USBD_FAIL;
+  }
+
+  if (hhid->state[index] != HID_IDLE)
+  {
+    /* Previous report still in flight: caller keeps it pending */
+    return USBD_BUSY;
+  }
+
+  hhid->state[index] = HID_BUSY;
+  USBD_LL_Transmit(pdev,
+                   ep_addr,
+                   report,
+                   len);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_StageReportEP
+  *         Stage the next HID Report behind the one in flight
+  * @param  pdev: device instance
+  * @param  ep_addr: HID_EPIN_ADDR, or HID_EPIN2_ADDR with HID_JOYSTICK_DUAL_EP
+  * @param  buff: pointer to report
+  * @note   The report is written into the endpoint's idle PMA buffer and
+  *         armed from DataIn as soon as the previous one completes, so the
+  *         next IN token finds it ready. Staging again replaces it.
+  * @retval USBD_OK if staged, USBD_BUSY if the endpoint is idle (use
+  *         USBD_HID_SendReportEP), USBD_FAIL if the device is not configured
+  */
+uint8_t USBD_HID_StageReportEP(USBD_HandleTypeDef  *pdev,
+                               uint8_t ep_addr,
+                               uint8_t *report,
+                               uint16_t len)
 {
   USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef *)pdev->pClassData;
+  uint8_t index = HID_EPIN_INDEX(ep_addr);
+
+  if (pdev->dev_state != USBD_STATE_CONFIGURED || index >= hid_num_interfaces || len == 0U)
+  {
+    return USBD_FAIL;
+  }
+
+  if (hhid->state[index] == HID_IDLE)
+  {
+    return USBD_BUSY;
+  }
 
-  if (pdev->dev_state == USBD_STATE_CONFIGURED)
+  if (USBD_LL_StageTransmit(pdev, ep_addr, report, len) != USBD_OK)
   {
-    if (hhid->state == HID_IDLE)
-    {
-      hhid->state = HID_BUSY;
-      USBD_LL_Transmit(pdev,
-                       HID_EPIN_ADDR,
-                       report,
-                       len);
-    }
+    return USBD_FAIL;
   }
+
+  hhid->staged_len[index] = len;
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_GetReportBufferEP
+  *         Packet memory buffer the next HID Report can be written into
+  * @param  pdev: device instance
+  * @param  ep_addr: HID_EPIN_ADDR, or HID_EPIN2_ADDR with HID_JOYSTICK_DUAL_EP
+  * @param  len: report length
+  * @note   Write the report with USBD_PMA_WORD(), then hand it over with
+  *         USBD_HID_CommitReportEP(). The buffer is never the one in
+  *         flight; it may hold a staged report, which is replaced.
+  * @retval buffer, NULL if the device is not configured
+  */
+volatile uint16_t *USBD_HID_GetReportBufferEP(USBD_HandleTypeDef  *pdev,
+                                              uint8_t ep_addr,
+                                              uint16_t len)
+{
+  uint8_t index = HID_EPIN_INDEX(ep_addr);
+
+  if (pdev->dev_state != USBD_STATE_CONFIGURED || index >= hid_num_interfaces || len == 0U)
+  {
+    return NULL;
+  }
+
+  return USBD_LL_GetStagingBuffer(pdev, ep_addr, len);
+}
+
+/**
+  * @brief  USBD_HID_CommitReportEP
+  *         Send or stage the report written by the caller
+  * @param  pdev: device instance
+  * @param  ep_addr: HID_EPIN_ADDR, or HID_EPIN2_ADDR with HID_JOYSTICK_DUAL_EP
+  * @param  len: report length
+  * @note   Must follow USBD_HID_GetReportBufferEP() with interrupts masked
+  *         in between, so the endpoint state cannot change.
+  * @retval USBD_OK if armed now, USBD_BUSY if staged behind the report in
+  *         flight (armed from DataIn)
+  */
+uint8_t USBD_HID_CommitReportEP(USBD_HandleTypeDef  *pdev,
+                                uint8_t ep_addr,
+                                uint16_t len)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef *)pdev->pClassData;
+  uint8_t index = HID_EPIN_INDEX(ep_addr);
+
+  if (hhid->state[index] != HID_IDLE)
+  {
+    hhid->staged_len[index] = len;
+    return USBD_BUSY;
+  }
+
+  hhid->state[index] = HID_BUSY;
+  USBD_LL_TransmitStaged(pdev, ep_addr, len);
   return USBD_OK;
 }
 
@@ -686,12 +848,129 @@ uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev)
   {
     /* Sets the data transfer polling interval for low and full
     speed transfers */
-    polling_interval =  HID_FS_BINTERVAL;
+    polling_interval =  hid_fs_binterval;
   }
 
   return ((uint32_t)(polling_interval));
 }
 
+/**
+  * @brief  USBD_HID_GetProtocol
+  *         return the protocol selected by the host (SET_PROTOCOL)
+  * @param  pdev: device instance
+  * @retval HID_PROTOCOL_BOOT or HID_PROTOCOL_REPORT
+  */
+uint8_t USBD_HID_GetProtocol(USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_HandleTypeDef *hhid = (USBD_HID_HandleTypeDef *)pdev->pClassData;
+
+  if (hhid == NULL)
+  {
+    return HID_PROTOCOL_REPORT;
+  }
+
+  return (uint8_t)hhid->Protocol;
+}
+
+/**
+  * @brief  USBD_HID_SetPollingInterval
+  *         select the full-speed endpoint polling interval
+  * @param  interval_ms: bInterval in ms (1-255)
+  * @note   Takes effect at the next enumeration; call before
+  *         MX_USB_DEVICE_Init() to apply it from the first one.
+  * @retval None
+  */
+void USBD_HID_SetPollingInterval(uint8_t interval_ms)
+{
+  if (interval_ms != 0U)
+  {
+    hid_fs_binterval = interval_ms;
+  }
+}
+
+/**
+  * @brief  USBD_HID_SetDeviceMode
+  *         select the interfaces presented to the host
+  * @param  mode: DEVICE_MODE_KEYBOARD, DEVICE_MODE_JOYSTICK or DEVICE_MODE_JVS
+  * @note   Call before MX_USB_DEVICE_Init(); the mode must not change
+  *         while the device is enumerated.
+  * @retval None
+  */
+void USBD_HID_SetDeviceMode(uint8_t mode)
+{
+  hid_num_interfaces = 1U;
+  hid_subclass = 0x00U;
+  hid_protocol = 0x00U;
+
+  switch (mode)
+  {
+    case DEVICE_MODE_KEYBOARD:
+      hid_subclass = HID_KEYBOARD_SUBCLASS;
+      hid_protocol = HID_KEYBOARD_PROTOCOL;
+      hid_epin_size = HID_KEYBOARD_EPIN_SIZE;
+      hid_if_report_desc_size = HID_KEYBOARD_REPORT_DESC_SIZE;
+      hid_report_desc = HID_KEYBOARD_ReportDesc;
+      break;
+
+    case DEVICE_MODE_JOYSTICK:
+      hid_epin_size = HID_JOYSTICK_EPIN_SIZE;
+      hid_if_report_desc_size = HID_JOYSTICK_REPORT_DESC_SIZE;
+      /* Prefer project's custom joystick descriptor when available */
+#ifdef HID_REPORT_DESC_SIZE_CUSTOM
+      hid_report_desc = (uint8_t *)HID_JOYSTICK_ReportDesc_Custom;
+#else
+      hid_report_desc = HID_JOYSTICK_ReportDesc;
+#endif
+#if HID_JOYSTICK_DUAL_EP
+      hid_num_interfaces = HID_NUM_INTERFACES;
+      hid_if_report_desc_size = HID_PLAYER_REPORT_DESC_SIZE;
+#endif
+      break;
+
+    case DEVICE_MODE_JVS:
+    default:
+      hid_epin_size = HID_JVS_EPIN_SIZE;
+      hid_if_report_desc_size = HID_JVS_REPORT_DESC_SIZE;
+      hid_report_desc = HID_JVS_ReportDesc;
+      break;
+  }
+}
+
+/**
+  * @brief  USBD_HID_PatchCfgDesc
+  *         write the device mode and polling interval into a configuration
+  *         descriptor
+  * @param  desc: configuration descriptor (sized for HID_NUM_INTERFACES
+  *         and the vendor data interface)
+  * @param  binterval: bInterval of the IN endpoints
+  * @retval wTotalLength for the mode
+  */
+static uint16_t USBD_HID_PatchCfgDesc(uint8_t *desc, uint8_t binterval)
+{
+  uint16_t total = 9U + (hid_num_interfaces * USB_HID_IF_DESC_SIZ);
+
+  /* Vendor data interface follows the game interfaces */
+  total += USBD_HID_RAW_WriteIfDesc(desc + total, hid_num_interfaces);
+
+  desc[2] = LOBYTE(total);
+  desc[3] = HIBYTE(total);
+  desc[4] = hid_num_interfaces + 1U;
+
+  for (uint8_t i = 0U; i < hid_num_interfaces; i++)
+  {
+    uint8_t *intf = desc + (i * USB_HID_IF_DESC_SIZ);
+
+    intf[HID_CFG_SUBCLASS_IDX] = hid_subclass;
+    intf[HID_CFG_PROTOCOL_IDX] = hid_protocol;
+    intf[HID_CFG_REPORT_LEN_IDX] = LOBYTE(hid_if_report_desc_size);
+    intf[HID_CFG_REPORT_LEN_IDX + 1U] = HIBYTE(hid_if_report_desc_size);
+    intf[HID_CFG_EPIN_SIZE_IDX] = hid_epin_size;
+    intf[HID_CFG_BINTERVAL_IDX] = binterval;
+  }
+
+  return total;
+}
+
 /**
   * @brief  USBD_HID_GetCfgFSDesc
   *         return FS configuration descriptor
@@ -701,7 +980,7 @@ uint32_t USBD_HID_GetPollingInterval(USBD_HandleTypeDef *pdev)
   */
 static uint8_t  *USBD_HID_GetFSCfgDesc(uint16_t *length)
 {
-  *length = sizeof(USBD_HID_CfgFSDesc);
+  *length = USBD_HID_PatchCfgDesc(USBD_HID_CfgFSDesc, hid_fs_binterval);
   return USBD_HID_CfgFSDesc;
 }
 
@@ -714,7 +993,7 @@ static uint8_t  *USBD_HID_GetFSCfgDesc(uint16_t *length)
   */
 static uint8_t  *USBD_HID_GetHSCfgDesc(uint16_t *length)
 {
-  *length = sizeof(USBD_HID_CfgHSDesc);
+  *length = USBD_HID_PatchCfgDesc(USBD_HID_CfgHSDesc, HID_HS_BINTERVAL);
   return USBD_HID_CfgHSDesc;
 }
 
@@ -727,7 +1006,7 @@ static uint8_t  *USBD_HID_GetHSCfgDesc(uint16_t *length)
   */
 static uint8_t  *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length)
 {
-  *length = sizeof(USBD_HID_OtherSpeedCfgDesc);
+  *length = USBD_HID_PatchCfgDesc(USBD_HID_OtherSpeedCfgDesc, hid_fs_binterval);
   return USBD_HID_OtherSpeedCfgDesc;
 }
 
@@ -741,13 +1020,88 @@ static uint8_t  *USBD_HID_GetOtherSpeedCfgDesc(uint16_t *length)
 static uint8_t  USBD_HID_DataIn(USBD_HandleTypeDef *pdev,
                                 uint8_t epnum)
 {
+  USBD_HID_HandleTypeDef *hhid = (USBD_HID_HandleTypeDef *)pdev->pClassData;
+  uint8_t index = HID_EPIN_INDEX(epnum);
+
+  if (epnum == (HID_RAW_EPIN_ADDR & 0x7FU))
+  {
+    return USBD_HID_RAW.DataIn(pdev, epnum);
+  }
+
+  if (hhid->staged_len[index] != 0U)
+  {
+    /* Ping-pong: arm the staged PMA buffer, the endpoint stays busy */
+    USBD_LL_TransmitStaged(pdev, (uint8_t)(epnum | 0x80U), hhid->staged_len[index]);
+    hhid->staged_len[index] = 0U;
+  }
+  else
+  {
+    /* Ensure that the FIFO is empty before a new transfer, this condition could
+    be caused by  a new transfer before the end of the previous transfer */
+    hhid->state[index] = HID_IDLE;
+  }
 
-  /* Ensure that the FIFO is empty before a new transfer, this condition could
-  be caused by  a new transfer before the end of the previous transfer */
-  ((USBD_HID_HandleTypeDef *)pdev->pClassData)->state = HID_IDLE;
+  /* Let the application queue its next report right away */
+  USBD_HID_DataInCallback(pdev, epnum);
   return USBD_OK;
 }
 
+/**
+  * @brief  USBD_HID_DataOut
+  *         handle data OUT Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+static uint8_t  USBD_HID_DataOut(USBD_HandleTypeDef *pdev,
+                                 uint8_t epnum)
+{
+  /* The game interfaces are IN only */
+  if (epnum == HID_RAW_EPOUT_ADDR)
+  {
+    return USBD_HID_RAW.DataOut(pdev, epnum);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_DataInCallback
+  *         called when an IN report has been delivered to the host
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number that completed
+  * @note   Weak: overridden by the report scheduler (usb_report.c)
+  * @retval None
+  */
+__weak void USBD_HID_DataInCallback(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  UNUSED(pdev);
+  UNUSED(epnum);
+}
+
+/**
+  * @brief  USBD_HID_SOF
+  *         handle Start Of Frame (every 1 ms while configured)
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_HID_SOF(USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_SOFCallback(pdev);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_SOFCallback
+  *         called on every Start Of Frame
+  * @param  pdev: device instance
+  * @note   Weak: overridden by the frame phase tracker (usb_frame.c)
+  * @retval None
+  */
+__weak void USBD_HID_SOFCallback(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
 
 /**
 * @brief  DeviceQualifierDescriptor
@@ -128,6 +128,16 @@ USBD_StatusTypeDef  USBD_LL_Transmit(USBD_HandleTypeDef *pdev,
                                      uint8_t  ep_addr,
                                      uint8_t  *pbuf,
                                      uint16_t  size);
+USBD_StatusTypeDef  USBD_LL_StageTransmit(USBD_HandleTypeDef *pdev,
+                                          uint8_t  ep_addr,
+                                          uint8_t  *pbuf,
+                                          uint16_t  size);
+USBD_StatusTypeDef  USBD_LL_TransmitStaged(USBD_HandleTypeDef *pdev,
+                                           uint8_t  ep_addr,
+                                           uint16_t  size);
+volatile uint16_t  *USBD_LL_GetStagingBuffer(USBD_HandleTypeDef *pdev,
+                                             uint8_t  ep_addr,
+                                             uint16_t  size);
 
 USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev,
                                            uint8_t  ep_addr,
@@ -77,12 +77,9 @@ void MX_USB_DEVICE_Init(void)
   {
     Error_Handler();
   }
-  // Registra la seconda interfaccia HID RAW
-  // NOTE: la registrazione di una seconda classe sovrascrive pdev->pClass
-  // nello stack ST, causando l'inattivazione della prima classe (tastiera).
-  // Per ripristinare rapidamente la tastiera, non registriamo qui la classe RAW.
-  // La gestione di due interfacce HID richiede un driver composito o un'unica
-  // classe HID che espone entrambe le interfacce.
+  // L'interfaccia HID RAW (usbd_hid_raw.c) non va registrata: lo stack ST
+  // gestisce una sola classe, quindi USBD_HID espone entrambe le interfacce
+  // e inoltra a USBD_HID_RAW le richieste e gli endpoint della seconda.
   if (USBD_Start(&hUsbDeviceFS) != USBD_OK)
   {
     Error_Handler();
@@ -46,7 +46,8 @@
 #include "usbd_conf.h"
 
 /* USER CODE BEGIN INCLUDE */
-#include "usbd_hid.h"  /* For mode selection defines */
+#include "usbd_hid.h"
+#include "device_mode.h"  /* Product string and bcdDevice follow the device mode */
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -90,60 +91,19 @@ __ALIGN_BEGIN uint8_t USBD_StringSerial[USB_SIZ_STRING_SERIAL] __ALIGN_END = {0}
 #define USBD_MANUFACTURER_STRING     "HIDO Project"
 #define USBD_PID_FS     22315
 
-#ifdef USE_KEYBOARD_MODE
-  #define USBD_PRODUCT_STRING_FS     "HIDO Arcade Keyboard"
-#elif defined(USE_JOYSTICK_MODE)
-  #define USBD_PRODUCT_STRING_FS     "HIDO Arcade Joystick"
-#elif defined(USE_JVS_MODE)
-  #define USBD_PRODUCT_STRING_FS     "HIDO JVS Interface"
-#else
-  #define USBD_PRODUCT_STRING_FS     "HIDO HID Device"
-#endif
+#define USBD_PRODUCT_STRING_KEYBOARD     "HIDO Arcade Keyboard"
+#define USBD_PRODUCT_STRING_JOYSTICK     "HIDO Arcade Joystick"
+#define USBD_PRODUCT_STRING_JVS          "HIDO JVS Interface"
+#define USBD_PRODUCT_STRING_FS     "HIDO HID Device"
+
+/* bcdDevice low byte of the device descriptor: device mode, so the host
+   does not reuse the cached descriptors of another mode */
+#define USBD_BCD_DEVICE_MODE_IDX   12
 
 #define USBD_CONFIGURATION_STRING_FS     "HID Config"
 #define USBD_INTERFACE_STRING_FS     "HID Interface"
 #define USBD_INTERFACE2_STRING_FS    "HIDO Config"
 
-
-// Endpoint e dimensioni per interfaccia RAW (seconda interfaccia)
-#define HID_RAW_EPIN_ADDR             0x82
-#define HID_RAW_EPOUT_ADDR            0x02
-#define HID_RAW_EPIN_SIZE             0x40
-#define HID_RAW_EPOUT_SIZE            0x40
-#define HID_RAW_REPORT_DESC_SIZE      0x41 // 65 byte, vedi usbd_hid_raw.h
-
-// Assicurati che le macro per la prima interfaccia (custom) esistano
-#ifndef HID_CUSTOM_REPORT_DESC_SIZE
-#define HID_CUSTOM_REPORT_DESC_SIZE   0x3F
-#endif
-#ifndef HID_EPOUT_ADDR
-#define HID_EPOUT_ADDR                0x01
-#endif
-#ifndef HID_EPOUT_SIZE
-#define HID_EPOUT_SIZE                0x40
-#endif
-
-
-// Le define per la prima interfaccia (custom) sono già presenti in usbd_hid.h
-// Non ridefinire qui per evitare conflitti
-// Include per tipi standard
-#include <stdint.h>
-
-// Endpoint e dimensioni per interfaccia RAW (seconda interfaccia)
-#define HID_RAW_EPIN_ADDR             0x82
-#define HID_RAW_EPOUT_ADDR            0x02
-#define HID_RAW_EPIN_SIZE             0x40
-#define HID_RAW_EPOUT_SIZE            0x40
-#define HID_RAW_REPORT_DESC_SIZE      0x41 // 65 byte, vedi usbd_hid_raw.h
-
-// Buffer per le stringhe USB
-// Endpoint e dimensioni per interfaccia custom (prima interfaccia)
-// #define HID_EPIN_ADDR                 0x81
-// #define HID_EPOUT_ADDR                0x01
-// #define HID_EPIN_SIZE                 0x40
-// #define HID_EPOUT_SIZE                0x40
-// #define HID_CUSTOM_REPORT_DESC_SIZE   0x3F
-
 // Buffer per le stringhe USB
 #define USB_MAX_STR_DESC_SIZ 64
 __ALIGN_BEGIN uint8_t USBD_StrDesc[USB_MAX_STR_DESC_SIZ] __ALIGN_END = {0};
@@ -236,7 +196,7 @@ __ALIGN_BEGIN uint8_t USBD_FS_DeviceDesc[USB_LEN_DEV_DESC] __ALIGN_END =
   HIBYTE(USBD_VID),           /*idVendor*/
   LOBYTE(USBD_PID_FS),        /*idProduct*/
   HIBYTE(USBD_PID_FS),        /*idProduct*/
-  0x00,                       /*bcdDevice rel. 2.00*/
+  0x00,                       /*bcdDevice rel. 2.00 (+ device mode)*/
   0x02,
   USBD_IDX_MFC_STR,           /*Index of manufacturer  string*/
   USBD_IDX_PRODUCT_STR,       /*Index of product string*/
@@ -271,103 +231,6 @@ __ALIGN_BEGIN uint8_t USBD_LangIDDesc[USB_LEN_LANGID_STR_DESC] __ALIGN_END =
 #if defined ( __ICCARM__ ) /* IAR Compiler */
   #pragma data_alignment=4
 #endif /* defined ( __ICCARM__ ) */
-/* Internal string descriptor. */
-// Nuovo descrittore di configurazione con 2 interfacce HID (standard + RAW)
-__ALIGN_BEGIN uint8_t USBD_FS_CfgDesc[]  __ALIGN_END =
-{
-  /* Configuration Descriptor */
-  0x09,   /* bLength: Configuration Descriptor size */
-  USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
-  0x49, 0x00, /* wTotalLength: 73 bytes (9 + 2*(9+9+7+7)) */
-  0x02,   /* bNumInterfaces: 2 interfaces */
-  0x01,   /* bConfigurationValue: Configuration value */
-  0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
-  0xE0,   /* bmAttributes: bus powered, remote wakeup */
-  0x32,   /* MaxPower 100 mA: this current is used for detecting Vbus */
-
-  /*---------------------------------------------------------------------------*/
-  /* Interface 0: HID standard (joystick/keyboard) */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface descriptor type */
-  0x00,   /* bInterfaceNumber: 0 */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints */
-  0x03,   /* bInterfaceClass: HID */
-  0x00,   /* bInterfaceSubClass : 1=BOOT, 0=no boot */
-  0x00,   /* nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse */
-  0x00,   /* iInterface: */
-
-  /* HID Descriptor (standard) */
-  0x09,   /* bLength: HID Descriptor size */
-  HID_DESCRIPTOR_TYPE, /* bDescriptorType: HID */
-  0x11,   /* bcdHID: HID Class Spec release number */
-  0x01,
-  0x00,   /* bCountryCode: Hardware target country */
-  0x01,   /* bNumDescriptors: Number of HID class descriptors to follow */
-  0x22,   /* bDescriptorType */
-  HID_CUSTOM_REPORT_DESC_SIZE,/* wItemLength: Total length of Report descriptor */
-  0x00,
-
-  /* Endpoint Descriptor IN (standard) */
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: */
-  HID_EPIN_ADDR,     /* bEndpointAddress: Endpoint Address (IN) */
-  0x03,   /* bmAttributes: Interrupt endpoint */
-  HID_EPIN_SIZE,     /* wMaxPacketSize: */
-  0x00,
-  HID_FS_BINTERVAL,          /* bInterval: */
-
-  /* Endpoint Descriptor OUT (standard) */
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: */
-  HID_EPOUT_ADDR,    /* bEndpointAddress: Endpoint Address (OUT) */
-  0x03,   /* bmAttributes: Interrupt endpoint */
-  HID_EPOUT_SIZE,    /* wMaxPacketSize: */
-  0x00,
-  HID_FS_BINTERVAL,          /* bInterval: */
-
-  /*---------------------------------------------------------------------------*/
-  /* Interface 1: HID RAW (config) */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface descriptor type */
-  0x01,   /* bInterfaceNumber: 1 */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints */
-  0x03,   /* bInterfaceClass: HID */
-  0x00,   /* bInterfaceSubClass : 0 */
-  0x00,   /* nInterfaceProtocol : 0 */
-  0x00,   /* iInterface: no string */
-
-  /* HID Descriptor (RAW) */
-  0x09,   /* bLength: HID Descriptor size */
-  HID_DESCRIPTOR_TYPE, /* bDescriptorType: HID */
-  0x11,   /* bcdHID: HID Class Spec release number */
-  0x01,
-  0x00,   /* bCountryCode: Hardware target country */
-  0x01,   /* bNumDescriptors: Number of HID class descriptors to follow */
-  0x22,   /* bDescriptorType */
-  HID_RAW_REPORT_DESC_SIZE,/* wItemLength: Total length of Report descriptor (RAW) */
-  0x00,
-
-  /* Endpoint Descriptor IN (RAW) */
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: */
-  HID_RAW_EPIN_ADDR,     /* bEndpointAddress: Endpoint Address (IN) */
-  0x03,   /* bmAttributes: Interrupt endpoint */
-  HID_RAW_EPIN_SIZE,     /* wMaxPacketSize: */
-  0x00,
-  HID_FS_BINTERVAL,          /* bInterval: */
-
-  /* Endpoint Descriptor OUT (RAW) */
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: */
-  HID_RAW_EPOUT_ADDR,    /* bEndpointAddress: Endpoint Address (OUT) */
-  0x03,   /* bmAttributes: Interrupt endpoint */
-  HID_RAW_EPOUT_SIZE,    /* wMaxPacketSize: */
-  0x00,
-  HID_FS_BINTERVAL,          /* bInterval: */
-};
-
 /**
   * @brief  Return the manufacturer string descriptor
   * @param  speed : Current device speed
@@ -498,6 +361,7 @@ static void IntToUnicode(uint32_t value, uint8_t * pbuf, uint8_t len)
 uint8_t * USBD_FS_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
 {
   UNUSED(speed);
+  USBD_FS_DeviceDesc[USBD_BCD_DEVICE_MODE_IDX] = (uint8_t)DeviceMode_Get();
   *length = sizeof(USBD_FS_DeviceDesc);
   return (uint8_t*)USBD_FS_DeviceDesc;
 }
@@ -512,7 +376,17 @@ uint8_t * USBD_FS_LangIDStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
 uint8_t * USBD_FS_ProductStrDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
 {
   UNUSED(speed);
-  USBD_GetString((uint8_t *)USBD_PRODUCT_STRING_FS, USBD_StrDesc, length);
+  const char *product;
+
+  switch (DeviceMode_Get())
+  {
+    case DEVICE_MODE_KEYBOARD: product = USBD_PRODUCT_STRING_KEYBOARD; break;
+    case DEVICE_MODE_JOYSTICK: product = USBD_PRODUCT_STRING_JOYSTICK; break;
+    case DEVICE_MODE_JVS:      product = USBD_PRODUCT_STRING_JVS; break;
+    default:                   product = USBD_PRODUCT_STRING_FS; break;
+  }
+
+  USBD_GetString((uint8_t *)product, USBD_StrDesc, length);
   return USBD_StrDesc;
 }
 /**
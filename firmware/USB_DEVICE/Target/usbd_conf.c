@@ -44,6 +44,23 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN 0 */
 
+/* Packet memory (512 bytes): buffer table for EP0-EP3 at 0x00-0x1F, then
+   the endpoint buffers.
+
+   The HID IN endpoints have two TX buffers each. The USB peripheral only
+   double-buffers bulk and isochronous endpoints, so interrupt endpoints get
+   a software ping-pong instead: the endpoint points at one buffer while the
+   next report is staged in the other (see USBD_LL_StageTransmit /
+   USBD_LL_TransmitStaged) */
+#define EP0_OUT_PMA             0x020U
+#define EP0_IN_PMA              0x060U
+#define HID_EPIN_PMA_BUF0       0x0A0U  /* 64 bytes: largest HID packet (JVS) */
+#define HID_EPIN_PMA_BUF1       0x0E0U
+#define HID_RAW_EPOUT_PMA       0x120U
+#define HID_RAW_EPIN_PMA        0x160U
+#define HID_EPIN2_PMA_BUF0      0x1A0U  /* 32 bytes: player 2 joystick reports only */
+#define HID_EPIN2_PMA_BUF1      0x1C0U
+
 /* USER CODE END 0 */
 
 /* USER CODE BEGIN PFP */
@@ -78,7 +95,7 @@ void HAL_PCD_MspInit(PCD_HandleTypeDef* pcdHandle)
     __HAL_RCC_USB_CLK_ENABLE();
 
     /* Peripheral interrupt init */
-    HAL_NVIC_SetPriority(USB_LP_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(USB_LP_IRQn, 1, 0);
     HAL_NVIC_EnableIRQ(USB_LP_IRQn);
   /* USER CODE BEGIN USB_MspInit 1 */
 
@@ -330,11 +347,18 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   HAL_PCD_RegisterIsoInIncpltCallback(&hpcd_USB_FS, PCD_ISOINIncompleteCallback);
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN EndPoint_Configuration */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, 0x18);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, 0x58);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, EP0_OUT_PMA);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, EP0_IN_PMA);
   /* USER CODE END EndPoint_Configuration */
   /* USER CODE BEGIN EndPoint_Configuration_HID */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x81 , PCD_SNG_BUF, 0x100);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , HID_EPIN_ADDR , PCD_SNG_BUF, HID_EPIN_PMA_BUF0);
+#if HID_EPIN_COUNT > 1
+  /* Player 2 interface endpoint (HID_JOYSTICK_DUAL_EP) */
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , HID_EPIN2_ADDR , PCD_SNG_BUF, HID_EPIN2_PMA_BUF0);
+#endif
+  /* Vendor data interface (usbd_hid_raw.c) */
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , HID_RAW_EPOUT_ADDR , PCD_SNG_BUF, HID_RAW_EPOUT_PMA);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , HID_RAW_EPIN_ADDR , PCD_SNG_BUF, HID_RAW_EPIN_PMA);
   /* USER CODE END EndPoint_Configuration_HID */
   return USBD_OK;
 }
@@ -540,6 +564,116 @@ USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, u
   return usb_status;
 }
 
+/**
+  * @brief  Returns the PMA TX buffer of an endpoint that is not in use.
+  * @param  ep: IN endpoint
+  * @retval PMA address, 0 if the endpoint has no second buffer
+  */
+static uint16_t USBD_LL_IdleTxBuffer(PCD_EPTypeDef *ep)
+{
+  uint16_t buf0;
+  uint16_t buf1;
+
+  switch (ep->num)
+  {
+    case (HID_EPIN_ADDR & EP_ADDR_MSK):
+      buf0 = HID_EPIN_PMA_BUF0;
+      buf1 = HID_EPIN_PMA_BUF1;
+      break;
+#if HID_EPIN_COUNT > 1
+    case (HID_EPIN2_ADDR & EP_ADDR_MSK):
+      buf0 = HID_EPIN2_PMA_BUF0;
+      buf1 = HID_EPIN2_PMA_BUF1;
+      break;
+#endif
+    default:
+      return 0U;
+  }
+
+  return (ep->pmaadress == buf0) ? buf1 : buf0;
+}
+
+/**
+  * @brief  Writes the next packet of an IN endpoint into its idle PMA buffer.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  pbuf: Pointer to data to be sent
+  * @param  size: Data size (one packet)
+  * @note   The endpoint may still be sending; the packet goes out on
+  *         USBD_LL_TransmitStaged(). Staging again replaces it.
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_StageTransmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t size)
+{
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)pdev->pData;
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[ep_addr & EP_ADDR_MSK];
+  uint16_t pma = USBD_LL_IdleTxBuffer(ep);
+
+  if ((pma == 0U) || (size > ep->maxpacket))
+  {
+    return USBD_FAIL;
+  }
+
+  USB_WritePMA(hpcd->Instance, pbuf, pma, size);
+  return USBD_OK;
+}
+
+/**
+  * @brief  Returns the idle PMA buffer of an IN endpoint for in-place writing.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  size: Packet size that will be written
+  * @note   Access it with USBD_PMA_WORD(); the packet goes out on
+  *         USBD_LL_TransmitStaged(). This saves the RAM copy of
+  *         USBD_LL_StageTransmit() when the packet can be built in place.
+  * @retval Buffer, NULL if the endpoint has no second buffer
+  */
+volatile uint16_t *USBD_LL_GetStagingBuffer(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint16_t size)
+{
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)pdev->pData;
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[ep_addr & EP_ADDR_MSK];
+  uint16_t pma = USBD_LL_IdleTxBuffer(ep);
+
+  if ((pma == 0U) || (size > ep->maxpacket))
+  {
+    return NULL;
+  }
+
+  return (volatile uint16_t *)((uint32_t)hpcd->Instance + 0x400U + ((uint32_t)pma * PMA_ACCESS));
+}
+
+/**
+  * @brief  Switches an IN endpoint to its staged buffer and arms it.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  size: Size passed to USBD_LL_StageTransmit()
+  * @note   Call from the DataIn stage of the previous packet, while the
+  *         endpoint NAKs; no PMA copy is left between the two packets.
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_TransmitStaged(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint16_t size)
+{
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)pdev->pData;
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[ep_addr & EP_ADDR_MSK];
+  uint16_t pma = USBD_LL_IdleTxBuffer(ep);
+
+  if (pma == 0U)
+  {
+    return USBD_FAIL;
+  }
+
+  /* Single packet transfer, completed by the next CTR_TX */
+  ep->pmaadress = pma;
+  ep->xfer_len = 0U;
+  ep->xfer_count = 0U;
+
+  PCD_SET_EP_TX_ADDRESS(hpcd->Instance, ep->num, pma);
+  PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, size);
+  PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_VALID);
+
+  return USBD_OK;
+}
+
 /**
   * @brief  Prepares an endpoint for reception.
   * @param  pdev: Device handle
@@ -73,7 +73,7 @@
 /*---------- -----------*/
 #define USBD_SELF_POWERED     1
 /*---------- -----------*/
-#define HID_FS_BINTERVAL     0xA
+#define HID_FS_BINTERVAL     0x1
 
 /****************************************/
 /* #define for FS and HS identification */
@@ -105,6 +105,10 @@
 /** Alias for delay. */
 #define USBD_Delay          HAL_Delay
 
+/** 16-bit word n (bytes 2n, 2n+1) of a buffer from USBD_LL_GetStagingBuffer();
+    the F1 packet memory maps each 16-bit word on a 32-bit boundary. */
+#define USBD_PMA_WORD(buf, n)   ((buf)[(uint32_t)(n) * PMA_ACCESS])
+
 /* For footprint reasons and since only one allocation is handled in the HID class
    driver, the malloc/free is changed into a static allocation method */
 void *USBD_static_malloc(uint32_t size);
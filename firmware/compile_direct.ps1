@@ -34,7 +34,8 @@ New-Item -ItemType Directory -Path $BUILD_DIR | Out-Null
 # Compiler flags
 $MCU = "-mcpu=cortex-m3 -mthumb"
 
-# Mode -> preprocessor define selection
+# Mode -> preprocessor define selection (default device mode only, every
+# image contains all modes and can be switched at runtime)
 switch ($Mode.ToLower()) {
     'keyboard' { $MODE_DEF = '-DUSE_KEYBOARD_MODE' }
     'joystick' { $MODE_DEF = '-DUSE_JOYSTICK_MODE' }
@@ -62,6 +63,7 @@ $LDFLAGS = "$MCU -specs=nano.specs -TSTM32F102RBTX_FLASH.ld -Wl,--gc-sections -W
 $C_SOURCES = @(
     "Core/Src/main.c",
     "Core/Src/gpio.c",
+    "Core/Src/dma.c",
     "Core/Src/adc.c",
     "Core/Src/tim.c",
     "Core/Src/usart.c",
@@ -72,9 +74,20 @@ $C_SOURCES = @(
     "Core/Src/system_stm32f1xx.c",
     "Core/Src/arcade_joystick.c",
     "Core/Src/arcade_keyboard.c",
+    "Core/Src/input_scan.c",
+    "Core/Src/input_edge.c",
+    "Core/Src/input_debounce.c",
+    "Core/Src/input_core.c",
+    "Core/Src/input_socd.c",
+    "Core/Src/timebase.c",
     "Core/Src/usb_commands.c",
+    "Core/Src/usb_report.c",
+    "Core/Src/usb_frame.c",
+    "Core/Src/usb_latency.c",
+    "Core/Src/device_mode.c",
     "Core/Src/dfu_bootloader.c",
     "Core/Src/jvs_protocol.c",
+    "Core/Src/jvs_uart.c",
     "Core/Src/usbd_hid_custom.c",
     "Core/Src/usbd_hid_raw.c",
     "Core/Src/gpio_test.c",
@@ -21,8 +21,9 @@ CMD_CONFIG_RESET = 0xC2
 
 # Configuration constants
 CONFIG_MAGIC = 0x48494430  # "HID0"
-CONFIG_VERSION = 1
+CONFIG_VERSION = 4
 MAX_PINS = 17
+POLL_INTERVALS_MS = (1, 2, 4, 8, 10)  # Supported USB bInterval values
 
 # HID Keycode mapping (USB HID Usage IDs)
 HID_KEYS = {
@@ -143,6 +144,9 @@ def parse_keyboard_config(data):
         })
         offset += 18
     
+    config['poll_interval_ms'] = data[offset]
+    offset += 4  # poll_interval_ms + 3 reserved bytes
+    
     config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
     
     return config
@@ -184,6 +188,9 @@ def parse_joystick_config(data):
         })
         offset += 18
     
+    config['poll_interval_ms'] = data[offset]
+    offset += 4  # poll_interval_ms + 3 reserved bytes
+    
     config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
     
     return config
@@ -210,7 +217,8 @@ def print_keyboard_config(config):
         key_display = HID_KEYS.get(mapping['hid_keycode'], f"0x{mapping['hid_keycode']:02X}")
         print(f"{i:<6} {mapping['silk_pin']:<12} {mapping['key_name']:<8} {key_display} (0x{mapping['hid_keycode']:02X})")
     
-    print(f"\nCRC32: 0x{config['crc32']:08X}")
+    print(f"\nUSB poll interval: {config['poll_interval_ms']} ms")
+    print(f"CRC32: 0x{config['crc32']:08X}")
     print("="*70)
 
 def print_joystick_config(config):
@@ -233,7 +241,8 @@ def print_joystick_config(config):
     for i, mapping in enumerate(config['player2']):
         print(f"{i:<6} {mapping['silk_pin']:<12} {mapping['func_name']:<20}")
     
-    print(f"\nCRC32: 0x{config['crc32']:08X}")
+    print(f"\nUSB poll interval: {config['poll_interval_ms']} ms")
+    print(f"CRC32: 0x{config['crc32']:08X}")
     print("="*70)
 
 def reset_config(dev):
@@ -18,11 +18,22 @@ PRODUCT_ID = 0x572B # HIDO PID
 CMD_CONFIG_READ = 0xC0
 CMD_CONFIG_WRITE = 0xC1
 CMD_CONFIG_RESET = 0xC2
+CMD_GET_MODE = 0xC3        # Active device mode (1 byte)
+CMD_SET_MODE = 0xC4        # wValue = device mode, stored in flash, device resets
+CMD_GET_TIMING = 0xA1      # UsbFrameStats_t, wValue=1 clears after reading
+CMD_SET_SOF_OFFSET = 0xA2  # wValue = report load point in us after SOF
 
 # Configuration constants
 CONFIG_MAGIC = 0x48494430  # "HID0"
-CONFIG_VERSION = 1
+CONFIG_VERSION = 5
 MAX_PINS = 17
+POLL_INTERVALS_MS = (1, 2, 4, 8, 10)  # Supported USB bInterval values
+DEVICE_MODES = ('keyboard', 'joystick', 'jvs')  # DeviceMode_t values
+SOCD_MODES = ('off', 'neutral', 'last-win', 'up-priority')  # InputSocdMode_t values
+SOCD_OFFSET = 8 + 2 * MAX_PINS * 18 + 1  # socd_mode[2] after poll_interval_ms
+DEBOUNCE_MODES = ('delayed', 'eager')  # InputDebounceMode_t values
+DEBOUNCE_PIN_DEFAULT = 0xFF  # Pin uses the firmware's DEBOUNCE_DEFAULT
+DEBOUNCE_OFFSET = SOCD_OFFSET + 3  # debounce_mode[2][MAX_PINS] after reserved, by silk pin
 
 # HID Keycode mapping (USB HID Usage IDs)
 HID_KEYS = {
@@ -143,6 +154,13 @@ def parse_keyboard_config(data):
         })
         offset += 18
     
+    config['poll_interval_ms'] = data[offset]
+    config['socd_mode'] = [data[offset + 1], data[offset + 2]]
+    offset += 4  # poll_interval_ms, socd_mode[2], reserved
+    config['debounce_mode'] = [list(data[offset:offset + MAX_PINS]),
+                               list(data[offset + MAX_PINS:offset + 2 * MAX_PINS])]
+    offset += 2 * MAX_PINS + 2  # debounce_mode[2][MAX_PINS], reserved2[2]
+    
     config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
     
     return config
@@ -184,10 +202,43 @@ def parse_joystick_config(data):
         })
         offset += 18
     
+    config['poll_interval_ms'] = data[offset]
+    config['socd_mode'] = [data[offset + 1], data[offset + 2]]
+    offset += 4  # poll_interval_ms, socd_mode[2], reserved
+    config['debounce_mode'] = [list(data[offset:offset + MAX_PINS]),
+                               list(data[offset + MAX_PINS:offset + 2 * MAX_PINS])]
+    offset += 2 * MAX_PINS + 2  # debounce_mode[2][MAX_PINS], reserved2[2]
+    
     config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
     
     return config
 
+def socd_name(mode):
+    return SOCD_MODES[mode] if mode < len(SOCD_MODES) else f"unknown ({mode})"
+
+def set_socd(dev, data, player, mode):
+    """Change one player's SOCD mode in the active config and write it back"""
+    patched = bytearray(data)
+    patched[SOCD_OFFSET + player] = SOCD_MODES.index(mode)
+    return write_config(dev, bytes(patched))
+
+def debounce_name(mode):
+    if mode == DEBOUNCE_PIN_DEFAULT:
+        return "default"
+    return DEBOUNCE_MODES[mode] if mode < len(DEBOUNCE_MODES) else f"unknown ({mode})"
+
+def print_debounce(config):
+    for player, modes in enumerate(config['debounce_mode']):
+        custom = [f"{pin:X}={debounce_name(m)}" for pin, m in enumerate(modes) if m != DEBOUNCE_PIN_DEFAULT]
+        print(f"Debounce P{player + 1}: {', '.join(custom) if custom else 'default on every pin'}")
+
+def set_debounce(dev, data, player, silk_pin, mode):
+    """Change the debounce algorithm of one pin in the active config and write it back"""
+    patched = bytearray(data)
+    value = DEBOUNCE_PIN_DEFAULT if mode == 'default' else DEBOUNCE_MODES.index(mode)
+    patched[DEBOUNCE_OFFSET + player * MAX_PINS + silk_pin] = value
+    return write_config(dev, bytes(patched))
+
 def print_keyboard_config(config):
     """Display keyboard configuration"""
     print("\n" + "="*70)
@@ -210,7 +261,10 @@ def print_keyboard_config(config):
         key_display = HID_KEYS.get(mapping['hid_keycode'], f"0x{mapping['hid_keycode']:02X}")
         print(f"{i:<6} {mapping['silk_pin']:<12} {mapping['key_name']:<8} {key_display} (0x{mapping['hid_keycode']:02X})")
     
-    print(f"\nCRC32: 0x{config['crc32']:08X}")
+    print(f"\nUSB poll interval: {config['poll_interval_ms']} ms")
+    print(f"SOCD: P1 {socd_name(config['socd_mode'][0])}, P2 {socd_name(config['socd_mode'][1])}")
+    print_debounce(config)
+    print(f"CRC32: 0x{config['crc32']:08X}")
     print("="*70)
 
 def print_joystick_config(config):
@@ -233,7 +287,10 @@ def print_joystick_config(config):
     for i, mapping in enumerate(config['player2']):
         print(f"{i:<6} {mapping['silk_pin']:<12} {mapping['func_name']:<20}")
     
-    print(f"\nCRC32: 0x{config['crc32']:08X}")
+    print(f"\nUSB poll interval: {config['poll_interval_ms']} ms")
+    print(f"SOCD: P1 {socd_name(config['socd_mode'][0])}, P2 {socd_name(config['socd_mode'][1])}")
+    print_debounce(config)
+    print(f"CRC32: 0x{config['crc32']:08X}")
     print("="*70)
 
 def write_config(dev, config_data):
@@ -269,6 +326,92 @@ def reset_config(dev):
         print(f"ERROR resetting config: {e}")
         return False
 
+def get_mode(dev):
+    """Read the active device mode"""
+    try:
+        data = dev.ctrl_transfer(
+            bmRequestType=0xC0,  # Device-to-Host, Vendor, Device
+            bRequest=CMD_GET_MODE,
+            wValue=0,
+            wIndex=0,
+            data_or_wLength=1
+        )
+        if len(data) != 1 or data[0] >= len(DEVICE_MODES):
+            return None
+        return DEVICE_MODES[data[0]]
+    except usb.core.USBError:
+        # Firmware without runtime mode selection
+        return None
+
+def set_mode(dev, mode):
+    """Store a new device mode; the device resets and re-enumerates"""
+    try:
+        dev.ctrl_transfer(
+            bmRequestType=0x40,  # Host-to-Device, Vendor, Device
+            bRequest=CMD_SET_MODE,
+            wValue=DEVICE_MODES.index(mode),
+            wIndex=0,
+            data_or_wLength=0
+        )
+    except usb.core.USBError:
+        # The reset can cut the status stage short
+        pass
+    print(f"✓ Device mode set to {mode}, device is restarting")
+    return True
+
+def read_timing(dev, clear=False):
+    """Read report timing statistics (sample-to-poll age)"""
+    try:
+        data = dev.ctrl_transfer(
+            bmRequestType=0xC0,  # Device-to-Host, Vendor, Device
+            bRequest=CMD_GET_TIMING,
+            wValue=1 if clear else 0,
+            wIndex=0,
+            data_or_wLength=16
+        )
+        reports, age_min, age_avg, age_max, phase, offset, sof_sync = \
+            struct.unpack('<IHHHHHB', bytes(data[0:15]))
+        return {
+            'reports': reports,
+            'age_min_us': age_min,
+            'age_avg_us': age_avg,
+            'age_max_us': age_max,
+            'poll_phase_us': phase,
+            'load_offset_us': offset,
+            'sof_sync': bool(sof_sync)
+        }
+    except usb.core.USBError as e:
+        print(f"ERROR reading timing: {e}")
+        return None
+
+def print_timing(timing):
+    """Print report timing statistics"""
+    print("\n" + "="*70)
+    print("REPORT TIMING")
+    print("="*70)
+    print(f"SOF sync: {'on' if timing['sof_sync'] else 'off'}  (load offset {timing['load_offset_us']} us after SOF)")
+    print(f"Reports collected: {timing['reports']}")
+    print(f"Sample-to-poll age: min {timing['age_min_us']} us, "
+          f"avg {timing['age_avg_us']} us, max {timing['age_max_us']} us")
+    print(f"Last poll: {timing['poll_phase_us']} us after SOF")
+    print("="*70)
+
+def set_sof_offset(dev, offset_us):
+    """Set the report load point (used by SOF sync builds)"""
+    try:
+        dev.ctrl_transfer(
+            bmRequestType=0x40,  # Host-to-Device, Vendor, Device
+            bRequest=CMD_SET_SOF_OFFSET,
+            wValue=offset_us,
+            wIndex=0,
+            data_or_wLength=0
+        )
+        print(f"✓ Load offset set to {offset_us} us after SOF")
+        return True
+    except usb.core.USBError as e:
+        print(f"ERROR setting load offset: {e}")
+        return False
+
 def main():
     print("="*70)
     print("HIDO Configuration Tool v1.0")
@@ -291,19 +434,22 @@ def main():
     
     print(f"✓ Read {len(data)} bytes")
     
-    # Detect mode and parse
-    # For now, assume keyboard mode (check first mapping structure)
-    # In real implementation, you'd check device descriptor or ask firmware
+    # Detect mode and parse (older firmware does not report its mode)
+    mode = get_mode(dev)
+    if mode is not None:
+        print(f"✓ Device mode: {mode}")
     
     try:
+        if mode in ("joystick", "jvs"):
+            raise ValueError("joystick mapping")  # JVS shares the joystick mapping
         config = parse_keyboard_config(data)
         print_keyboard_config(config)
-        mode = "keyboard"
+        mode = mode or "keyboard"
     except:
         try:
             config = parse_joystick_config(data)
             print_joystick_config(config)
-            mode = "joystick"
+            mode = mode or "joystick"
         except Exception as e:
             print(f"ERROR parsing config: {e}")
             return 1
@@ -314,6 +460,11 @@ def main():
         print("  [R] Reset to defaults")
         print("  [E] Export to JSON")
         print("  [I] Import from JSON")
+        print("  [T] Report timing (read and clear)")
+        print("  [O] Set SOF load offset")
+        print("  [S] Set SOCD mode (opposite directions)")
+        print("  [D] Set debounce algorithm of one pin")
+        print("  [M] Change device mode (keyboard/joystick/jvs)")
         print("  [Q] Quit")
         
         choice = input("\nSelect option: ").strip().upper()
@@ -355,6 +506,54 @@ def main():
             except json.JSONDecodeError as e:
                 print(f"ERROR: Invalid JSON file: {e}")
         
+        elif choice == 'T':
+            timing = read_timing(dev, clear=True)
+            if timing:
+                print_timing(timing)
+        
+        elif choice == 'O':
+            try:
+                offset = int(input("Load offset in us after SOF (0-999): ").strip())
+                if 0 <= offset < 1000:
+                    set_sof_offset(dev, offset)
+                else:
+                    print("ERROR: Offset must be 0-999")
+            except ValueError:
+                print("ERROR: Not a number")
+        
+        elif choice == 'S':
+            player = input("Player (1/2): ").strip()
+            socd = input(f"SOCD mode ({'/'.join(SOCD_MODES)}): ").strip().lower()
+            if player not in ('1', '2') or socd not in SOCD_MODES:
+                print("ERROR: Invalid player or mode")
+            elif set_socd(dev, data, int(player) - 1, socd):
+                data = read_config(dev)
+                if data:
+                    config = parse_keyboard_config(data) if mode == "keyboard" else parse_joystick_config(data)
+        
+        elif choice == 'D':
+            player = input("Player (1/2): ").strip()
+            pin = input("Silk pin (0-10, hex): ").strip()
+            algo = input(f"Debounce ({'/'.join(DEBOUNCE_MODES)}/default): ").strip().lower()
+            try:
+                silk_pin = int(pin, 16)
+            except ValueError:
+                silk_pin = -1
+            if player not in ('1', '2') or not 0 <= silk_pin < MAX_PINS or \
+                    algo not in DEBOUNCE_MODES + ('default',):
+                print("ERROR: Invalid player, pin or algorithm")
+            elif set_debounce(dev, data, int(player) - 1, silk_pin, algo):
+                data = read_config(dev)
+                if data:
+                    config = parse_keyboard_config(data) if mode == "keyboard" else parse_joystick_config(data)
+        
+        elif choice == 'M':
+            new_mode = input(f"Device mode ({'/'.join(DEVICE_MODES)}): ").strip().lower()
+            if new_mode in DEVICE_MODES:
+                set_mode(dev, new_mode)
+                break
+            print("ERROR: Unknown mode")
+        
         elif choice == 'Q':
             break
     
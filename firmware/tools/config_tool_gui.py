@@ -25,8 +25,9 @@ CMD_GET_VERSION = 0xAA
 
 # Configuration constants
 CONFIG_MAGIC = 0x48494430  # "HID0"
-CONFIG_VERSION = 1
+CONFIG_VERSION = 5
 MAX_PINS = 17
+POLL_INTERVALS_MS = (1, 2, 4, 8, 10)  # Supported USB bInterval values
 
 # HID Keycode mapping (USB HID Usage IDs)
 HID_KEYS = {
@@ -374,6 +375,13 @@ Configuration:
             })
             offset += 18
         
+        config['poll_interval_ms'] = data[offset]
+        config['socd_mode'] = [data[offset + 1], data[offset + 2]]
+        offset += 4  # poll_interval_ms, socd_mode[2], reserved
+        config['debounce_mode'] = [list(data[offset:offset + MAX_PINS]),
+                                   list(data[offset + MAX_PINS:offset + 2 * MAX_PINS])]
+        offset += 2 * MAX_PINS + 2  # debounce_mode[2][MAX_PINS], reserved2[2]
+        
         config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
         
         return config
@@ -415,6 +423,13 @@ Configuration:
             })
             offset += 18
         
+        config['poll_interval_ms'] = data[offset]
+        config['socd_mode'] = [data[offset + 1], data[offset + 2]]
+        offset += 4  # poll_interval_ms, socd_mode[2], reserved
+        config['debounce_mode'] = [list(data[offset:offset + MAX_PINS]),
+                                   list(data[offset + MAX_PINS:offset + 2 * MAX_PINS])]
+        offset += 2 * MAX_PINS + 2  # debounce_mode[2][MAX_PINS], reserved2[2]
+        
         config['crc32'] = struct.unpack('<I', data[offset:offset+4])[0]
         
         return config
@@ -561,6 +576,19 @@ Configuration:
             data.extend(name)
             data.extend(b'\x00' * (16 - len(name)))  # Pad to 16 bytes
         
+        # USB poll interval, SOCD mode per player (kept as read), reserved byte
+        poll = self.config.get('poll_interval_ms', 1)
+        if poll not in POLL_INTERVALS_MS:
+            poll = 1
+        data.append(poll)
+        data.extend(bytes(self.config.get('socd_mode', [0, 0])))
+        data.append(0)
+        
+        # Debounce algorithm per silk pin (kept as read, 0xFF = firmware default), reserved bytes
+        for modes in self.config.get('debounce_mode', [[0xFF] * MAX_PINS] * 2):
+            data.extend(bytes(modes))
+        data.extend(b'\x00' * 2)
+        
         # CRC32 (simplified - just use existing CRC or 0)
         crc = self.config.get('crc32', 0)
         data.extend(struct.pack('<I', crc))
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""
+HIDO vendor data interface
+Talks to the device through its vendor-defined HID interface (64-byte
+reports) using hidapi, so no kernel driver has to be detached and no EP0
+control transfers are needed.
+
+Requires: pip install hidapi
+"""
+
+import struct
+import sys
+
+try:
+    import hid
+except ImportError:
+    hid = None
+
+# USB IDs
+VENDOR_ID = 0x0483  # STMicroelectronics VID
+PRODUCT_ID = 0x572B # HIDO PID
+
+RAW_USAGE_PAGE = 0xFF00
+REPORT_SIZE = 64
+HEADER_SIZE = 4
+PAYLOAD_SIZE = REPORT_SIZE - HEADER_SIZE
+
+# Commands (same codes as the EP0 vendor requests)
+CMD_GET_TIMING = 0xA1
+CMD_SET_SOF_OFFSET = 0xA2
+CMD_GET_JVS_TIMING = 0xA4
+CMD_SET_JVS_TURNAROUND = 0xA5
+CMD_GET_VERSION = 0xAA
+CMD_CONFIG_READ = 0xC0
+CMD_CONFIG_WRITE = 0xC1
+CMD_CONFIG_RESET = 0xC2
+CMD_GET_MODE = 0xC3
+CMD_SET_MODE = 0xC4
+
+STATUS_OK = 0x00
+STATUS_NAMES = {0x00: 'ok', 0x01: 'error', 0x02: 'unknown command'}
+
+DEVICE_MODES = ('keyboard', 'joystick', 'jvs')
+
+
+class RawError(Exception):
+    pass
+
+
+class HidoRaw:
+    """Vendor data interface of one HIDO device"""
+
+    def __init__(self, path=None, timeout_ms=500):
+        if hid is None:
+            raise RawError("hidapi not installed (pip install hidapi)")
+        if path is None:
+            path = find_raw_interface()
+            if path is None:
+                raise RawError("HIDO vendor interface not found")
+        self.dev = hid.device()
+        self.dev.open_path(path)
+        self.timeout_ms = timeout_ms
+
+    def close(self):
+        self.dev.close()
+
+    def send(self, cmd, value=0, payload=b''):
+        """Send one command report"""
+        if len(payload) > PAYLOAD_SIZE:
+            raise RawError("payload too long")
+        report = struct.pack('<BHB', cmd, value, len(payload)) + bytes(payload)
+        report += bytes(REPORT_SIZE - len(report))
+        # Leading 0: no report ID
+        self.dev.write(b'\x00' + report)
+
+    def read(self, timeout_ms=None):
+        """Read one IN report, None on timeout"""
+        data = self.dev.read(REPORT_SIZE, timeout_ms or self.timeout_ms)
+        return bytes(data) if data else None
+
+    def command(self, cmd, value=0, payload=b''):
+        """Send a command and wait for its reply, returns the reply data"""
+        self.send(cmd, value, payload)
+        while True:
+            reply = self.read()
+            if reply is None:
+                raise RawError(f"no reply to command 0x{cmd:02X}")
+            # Other reports (e.g. telemetry) may be interleaved
+            if reply[0] != cmd:
+                continue
+            status, length = reply[1], reply[2]
+            if status != STATUS_OK:
+                raise RawError(f"command 0x{cmd:02X}: {STATUS_NAMES.get(status, status)}")
+            return reply[HEADER_SIZE:HEADER_SIZE + length]
+
+    def get_version(self):
+        return tuple(self.command(CMD_GET_VERSION))
+
+    def get_mode(self):
+        mode = self.command(CMD_GET_MODE)[0]
+        return DEVICE_MODES[mode] if mode < len(DEVICE_MODES) else mode
+
+    def get_timing(self, clear=False):
+        data = self.command(CMD_GET_TIMING, 1 if clear else 0)
+        reports, age_min, age_avg, age_max, phase, offset, sof_sync, _ = \
+            struct.unpack('<IHHHHHBB', data[:16])
+        return {
+            'reports': reports,
+            'age_min_us': age_min,
+            'age_avg_us': age_avg,
+            'age_max_us': age_max,
+            'poll_phase_us': phase,
+            'load_offset_us': offset,
+            'sof_sync': bool(sof_sync)
+        }
+
+    def get_jvs_timing(self, clear=False):
+        data = self.command(CMD_GET_JVS_TIMING, 1 if clear else 0)
+        replies, resp_min, resp_avg, resp_max, transmit, turnaround, de_setup = \
+            struct.unpack('<IHHHHHH', data[:16])
+        return {
+            'replies': replies,
+            'response_min_us': resp_min,
+            'response_avg_us': resp_avg,
+            'response_max_us': resp_max,
+            'transmit_us': transmit,
+            'turnaround_us': turnaround,
+            'de_setup_us': de_setup
+        }
+
+    def set_jvs_turnaround(self, us):
+        self.command(CMD_SET_JVS_TURNAROUND, us)
+
+    def read_config(self):
+        """Read the active mode's configuration in PAYLOAD_SIZE chunks"""
+        data = b''
+        while True:
+            try:
+                chunk = self.command(CMD_CONFIG_READ, len(data))
+            except RawError:
+                if data:
+                    return data     # Offset past the end: done
+                raise
+            data += chunk
+            if len(chunk) < PAYLOAD_SIZE:
+                return data
+
+    def write_config(self, data):
+        """Write the active mode's configuration, chunks in order (saved with the last chunk)"""
+        for offset in range(0, len(data), PAYLOAD_SIZE):
+            self.command(CMD_CONFIG_WRITE, offset, data[offset:offset + PAYLOAD_SIZE])
+
+
+def find_raw_interface():
+    """Path of the HIDO vendor interface, or None"""
+    for info in hid.enumerate(VENDOR_ID, PRODUCT_ID):
+        # usage_page is not reported on every platform; fall back to the
+        # interface number (the vendor interface is always the last one)
+        if info.get('usage_page') == RAW_USAGE_PAGE:
+            return info['path']
+    candidates = [i for i in hid.enumerate(VENDOR_ID, PRODUCT_ID) if i.get('interface_number', -1) >= 1]
+    if candidates:
+        return max(candidates, key=lambda i: i['interface_number'])['path']
+    return None
+
+
+def main():
+    try:
+        raw = HidoRaw()
+    except RawError as e:
+        print(f"ERROR: {e}")
+        return 1
+
+    try:
+        major, minor, patch = raw.get_version()
+        print(f"Firmware: {major}.{minor}.{patch}")
+        mode = raw.get_mode()
+        print(f"Device mode: {mode}")
+        config = raw.read_config()
+        print(f"Config: {len(config)} bytes")
+        timing = raw.get_timing()
+        print(f"Reports: {timing['reports']}, age min/avg/max "
+              f"{timing['age_min_us']}/{timing['age_avg_us']}/{timing['age_max_us']} us")
+        if mode == 'jvs':
+            jvs = raw.get_jvs_timing()
+            print(f"JVS replies: {jvs['replies']}, response min/avg/max "
+                  f"{jvs['response_min_us']}/{jvs['response_avg_us']}/{jvs['response_max_us']} us, "
+                  f"turnaround {jvs['turnaround_us']} us")
+    except RawError as e:
+        print(f"ERROR: {e}")
+        return 1
+    finally:
+        raw.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+"""
+HIDO latency probe (Linux)
+Enables the firmware latency probe (USB_LATENCY_PROBE build) on the vendor
+interface and matches every probe packet with the evdev frame produced by
+the same HID report, then prints per-input latency histograms.
+
+For each input edge:
+  edge->load    edge to endpoint load (firmware)
+  load->poll    endpoint load to host collection (firmware)
+  device        edge to host collection (firmware, exact)
+  host          collection to evdev timestamp, relative to the fastest
+                delivery seen (the two clocks are aligned on the lower
+                envelope of collection->evdev, so this is host jitter)
+  total         device + host
+
+Usage:
+  latency_probe.py [--duration S] [--csv FILE] [--bucket US]
+  latency_probe.py --compare A.csv B.csv
+
+Needs read/write access to the HIDO hidraw and /dev/input/event* nodes
+(run as root or add a udev rule). No Python packages required.
+"""
+
+import argparse
+import csv
+import fcntl
+import glob
+import os
+import select
+import statistics
+import struct
+import sys
+import time
+
+VENDOR_ID = 0x0483
+PRODUCT_ID = 0x572B
+
+REPORT_SIZE = 64
+HEADER_SIZE = 4
+CMD_SET_LATENCY_PROBE = 0xA3
+EVENT_LATENCY = 0xE0
+STATUS_OK = 0x00
+TRUNCATED = 0x80
+
+# struct input_event: struct timeval, __u16 type, __u16 code, __s32 value
+INPUT_EVENT = struct.Struct('llHHi')
+EV_SYN = 0x00
+SYN_REPORT = 0
+EVIOCSCLOCKID = 0x400445A0      # _IOW('E', 0xa0, int)
+CLOCK_MONOTONIC = 1
+
+OFFSET_WINDOW_US = 2000000      # Clock offset: lower envelope over this window
+MATCH_TOLERANCE_US = 1500       # A frame further than this from its prediction is not ours
+
+METRICS = ('edge_load', 'load_poll', 'device', 'host', 'total')
+
+
+def sysfs_ids(path):
+    """(vendor, product) of a hidraw/input sysfs device, or None"""
+    try:
+        with open(os.path.join(path, 'device', 'uevent')) as f:
+            for line in f:
+                if line.startswith('HID_ID='):
+                    _, vid, pid = line.strip().split('=')[1].split(':')
+                    return int(vid, 16), int(pid, 16)
+    except OSError:
+        pass
+    return None
+
+
+def find_hidraw():
+    """/dev/hidrawN of the vendor interface"""
+    for node in sorted(glob.glob('/sys/class/hidraw/hidraw*')):
+        if sysfs_ids(node) != (VENDOR_ID, PRODUCT_ID):
+            continue
+        try:
+            with open(os.path.join(node, 'device', 'report_descriptor'), 'rb') as f:
+                desc = f.read()
+        except OSError:
+            continue
+        if desc[:3] == b'\x06\x00\xFF':
+            return '/dev/' + os.path.basename(node)
+    return None
+
+
+def find_evdev():
+    """/dev/input/eventN nodes of the game interface(s)"""
+    nodes = []
+    for node in sorted(glob.glob('/sys/class/input/event*')):
+        # event*/device is the input device, its parent the HID device
+        if sysfs_ids(os.path.join(node, 'device')) == (VENDOR_ID, PRODUCT_ID):
+            nodes.append('/dev/input/' + os.path.basename(node))
+    return nodes
+
+
+def now_us():
+    return time.clock_gettime_ns(time.CLOCK_MONOTONIC) // 1000
+
+
+def send_command(fd, cmd, value):
+    report = struct.pack('<BHB', cmd, value, 0) + bytes(REPORT_SIZE - HEADER_SIZE)
+    os.write(fd, b'\x00' + report)      # Report number 0: no report IDs
+
+
+def parse_probe(data):
+    """Decode a probe packet, None for any other report"""
+    if len(data) < HEADER_SIZE + 8 or data[0] != EVENT_LATENCY or data[1] != STATUS_OK:
+        return None
+    collect, load, slot, count = struct.unpack_from('<IHBB', data, HEADER_SIZE)
+    edges = []
+    for i in range(count & ~TRUNCATED):
+        edge, bit, pressed = struct.unpack_from('<HBB', data, HEADER_SIZE + 8 + 4 * i)
+        edges.append((bit, pressed, edge))
+    return {'collect': collect, 'load': load, 'slot': slot,
+            'edges': edges, 'truncated': bool(count & TRUNCATED)}
+
+
+class ClockModel:
+    """Device-to-host offset from the lower envelope of matched pairs"""
+
+    def __init__(self):
+        self.samples = []       # (host_us, offset_us)
+
+    def add(self, host_us, offset_us):
+        self.samples.append((host_us, offset_us))
+        while self.samples and host_us - self.samples[0][0] > OFFSET_WINDOW_US:
+            self.samples.pop(0)
+
+    def offset(self):
+        return min(o for _, o in self.samples) if self.samples else None
+
+
+def capture(args):
+    hidraw = find_hidraw()
+    evdev = find_evdev()
+    if hidraw is None or not evdev:
+        print("ERROR: HIDO vendor interface or input device not found")
+        return None
+
+    raw_fd = os.open(hidraw, os.O_RDWR | os.O_NONBLOCK)
+    ev_fds = []
+    for path in evdev:
+        fd = os.open(path, os.O_RDONLY | os.O_NONBLOCK)
+        fcntl.ioctl(fd, EVIOCSCLOCKID, struct.pack('i', CLOCK_MONOTONIC))
+        ev_fds.append(fd)
+
+    send_command(raw_fd, CMD_SET_LATENCY_PROBE, 1)
+    print(f"Probing {hidraw} + {', '.join(evdev)} for {args.duration} s, press buttons...")
+
+    frames = []             # Host times of evdev frames not matched yet
+    clock = ClockModel()
+    rows = []
+    probes = 0
+    dropped = 0
+    enabled = False
+    deadline = time.monotonic() + args.duration
+    dev_base = None         # Unwrapped device time of the first probe
+    last_collect = None
+
+    try:
+        while time.monotonic() < deadline:
+            ready, _, _ = select.select([raw_fd] + ev_fds, [], [], 0.1)
+            for fd in ready:
+                if fd != raw_fd:
+                    data = os.read(fd, INPUT_EVENT.size * 64)
+                    for off in range(0, len(data) - INPUT_EVENT.size + 1, INPUT_EVENT.size):
+                        sec, usec, etype, code, _ = INPUT_EVENT.unpack_from(data, off)
+                        if etype == EV_SYN and code == SYN_REPORT:
+                            frames.append(sec * 1000000 + usec)
+                    continue
+
+                data = os.read(raw_fd, REPORT_SIZE)
+                if data[0] == CMD_SET_LATENCY_PROBE:
+                    if data[1] != STATUS_OK:
+                        print("ERROR: firmware built without USB_LATENCY_PROBE")
+                        return None
+                    enabled = True
+                    continue
+                probe = parse_probe(data)
+                if probe is None or not probe['edges']:
+                    continue
+                probes += 1
+
+                # Unwrap the 32-bit device clock
+                collect = probe['collect']
+                if last_collect is None:
+                    dev_base = 0
+                elif collect < last_collect:
+                    dev_base += 1 << 32
+                last_collect = collect
+                collect_us = dev_base + collect
+
+                # The evdev frame of this report is the oldest one that fits
+                offset = clock.offset()
+                match = None
+                while frames:
+                    frame = frames[0]
+                    if offset is not None and frame - collect_us - offset < -MATCH_TOLERANCE_US:
+                        frames.pop(0)       # Older than this report: unmatched frame
+                        continue
+                    if offset is None or frame - collect_us - offset <= MATCH_TOLERANCE_US:
+                        match = frames.pop(0)
+                    break
+                if match is None:
+                    dropped += 1
+                    continue
+
+                clock.add(match, match - collect_us)
+                host = match - collect_us - clock.offset()
+                collect16 = collect & 0xFFFF
+                for bit, pressed, edge in probe['edges']:
+                    edge_load = (probe['load'] - edge) & 0xFFFF
+                    load_poll = (collect16 - probe['load']) & 0xFFFF
+                    device = (collect16 - edge) & 0xFFFF
+                    rows.append({'bit': bit, 'pressed': pressed, 'slot': probe['slot'],
+                                 'edge_load': edge_load, 'load_poll': load_poll,
+                                 'device': device, 'host': host, 'total': device + host})
+    finally:
+        try:
+            send_command(raw_fd, CMD_SET_LATENCY_PROBE, 0)
+        except OSError:
+            pass
+        os.close(raw_fd)
+        for fd in ev_fds:
+            os.close(fd)
+
+    if not enabled:
+        print("WARNING: no reply to the probe enable command")
+    print(f"{probes} probe packets, {len(rows)} edges, {dropped} without an evdev frame")
+    return rows
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(p / 100.0 * len(ordered)))]
+
+
+def summary_line(label, values):
+    return (f"{label:<12} n={len(values):<5} min={min(values):>5} med={int(statistics.median(values)):>5} "
+            f"p99={percentile(values, 99):>5} max={max(values):>5} us")
+
+
+def print_histogram(values, bucket):
+    counts = {}
+    for v in values:
+        counts[v // bucket] = counts.get(v // bucket, 0) + 1
+    peak = max(counts.values())
+    for b in range(min(counts), max(counts) + 1):
+        n = counts.get(b, 0)
+        print(f"  {b * bucket:>6}-{(b + 1) * bucket - 1:<6} {n:>5} {'#' * (n * 40 // peak)}")
+
+
+def report(rows, bucket):
+    groups = {}
+    for row in rows:
+        groups.setdefault((row['bit'], row['pressed']), []).append(row)
+
+    for (bit, pressed), group in sorted(groups.items()):
+        print(f"\nInput bit {bit} {'press' if pressed else 'release'}")
+        for metric in METRICS:
+            print("  " + summary_line(metric, [r[metric] for r in group]))
+        print_histogram([r['total'] for r in group], bucket)
+
+    if rows:
+        print("\nAll inputs")
+        for metric in METRICS:
+            print("  " + summary_line(metric, [r[metric] for r in rows]))
+
+
+def load_csv(path):
+    with open(path, newline='') as f:
+        return [{k: int(v) for k, v in row.items()} for row in csv.DictReader(f)]
+
+
+def compare(path_a, path_b):
+    a, b = load_csv(path_a), load_csv(path_b)
+    print(f"A: {path_a} ({len(a)} edges)\nB: {path_b} ({len(b)} edges)\n")
+    print(f"{'metric':<12} {'A med':>7} {'B med':>7} {'A p99':>7} {'B p99':>7}")
+    for metric in METRICS:
+        va, vb = [r[metric] for r in a], [r[metric] for r in b]
+        if not va or not vb:
+            continue
+        print(f"{metric:<12} {int(statistics.median(va)):>7} {int(statistics.median(vb)):>7} "
+              f"{percentile(va, 99):>7} {percentile(vb, 99):>7}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HIDO input latency probe (Linux)")
+    parser.add_argument('--duration', type=float, default=30.0, help="capture time in seconds")
+    parser.add_argument('--csv', help="write one row per edge to this file")
+    parser.add_argument('--bucket', type=int, default=250, help="histogram bucket in us")
+    parser.add_argument('--compare', nargs=2, metavar=('A', 'B'), help="compare two CSV captures")
+    args = parser.parse_args()
+
+    if args.compare:
+        compare(*args.compare)
+        return 0
+
+    rows = capture(args)
+    if rows is None:
+        return 1
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=['bit', 'pressed', 'slot'] + list(METRICS))
+            writer.writeheader()
+            writer.writerows(rows)
+    report(rows, args.bucket)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())